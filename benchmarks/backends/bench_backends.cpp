@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QScopedPointer>
+
+#include "persistencebackend.h"
+#include "notificationrecord.h"
+#include "benchrecords.h"
+
+static const int WorkloadSize = 1000;
+static const int PageSize = 20;
+
+// the odd ids are records of deepin-terminal, the even ones of dde-file-manager
+static NotificationRecord makeAppRecord(uint id)
+{
+    return makeRecord(id, id % 2 ? "deepin-terminal" : "dde-file-manager");
+}
+
+// The same workload against every backend: the checks make sure they behave the same,
+// the benchmarks compare them.
+class BackendsBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void reopen_data();
+    void reopen();
+    void added_data();
+    void added();
+    void page_data();
+    void page();
+    void pageByTime_data();
+    void pageByTime();
+    void remove_data();
+    void remove();
+    void removeMany_data();
+    void removeMany();
+    void search_data();
+    void search();
+    void retention_data();
+    void retention();
+    void changes_data();
+    void changes();
+
+    void benchmarkInsert_data();
+    void benchmarkInsert();
+    void benchmarkPage_data();
+    void benchmarkPage();
+    void benchmarkRemove_data();
+    void benchmarkRemove();
+
+private:
+    void addBackendRows();
+    PersistenceBackend *createBackend();
+    // a backend holding records 1 to count
+    PersistenceBackend *createFilledBackend(int count);
+
+private:
+    QTemporaryDir *m_dir = nullptr;
+};
+
+void BackendsBenchmark::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+}
+
+void BackendsBenchmark::cleanup()
+{
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+void BackendsBenchmark::addBackendRows()
+{
+    QTest::addColumn<QString>("backend");
+    QTest::addColumn<bool>("persistent");
+
+    QTest::newRow("sqlite") << "sqlite" << true;
+    QTest::newRow("memory") << "memory" << false;
+    QTest::newRow("log") << "log" << true;
+}
+
+PersistenceBackend *BackendsBenchmark::createBackend()
+{
+    QFETCH(QString, backend);
+
+    return PersistenceBackend::create(backend, m_dir->path());
+}
+
+PersistenceBackend *BackendsBenchmark::createFilledBackend(int count)
+{
+    PersistenceBackend *backend = createBackend();
+    backend->open();
+
+    for (int i = 1; i <= count; ++i) {
+        backend->addOne(makeAppRecord(i));
+    }
+    backend->flush();
+
+    return backend;
+}
+
+void BackendsBenchmark::reopen_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::reopen()
+{
+    QFETCH(bool, persistent);
+
+    {
+        QScopedPointer<PersistenceBackend> backend(createFilledBackend(10));
+        backend->removeOne("10");
+        backend->flush();
+    }
+
+    QScopedPointer<PersistenceBackend> backend(createBackend());
+
+    // ids are not used again, even the one of the removed record
+    QCOMPARE(backend->open(), persistent ? 10u : 0u);
+    QCOMPARE(backend->getAll().size(), persistent ? 9 : 0);
+}
+
+void BackendsBenchmark::added_data()
+{
+    addBackendRows();
+}
+
+// a record is announced once a new backend would read it
+void BackendsBenchmark::added()
+{
+    QFETCH(bool, persistent);
+
+    QScopedPointer<PersistenceBackend> backend(createBackend());
+    backend->open();
+    qRegisterMetaType<NotificationRecord>();
+    QSignalSpy added(backend.data(), &PersistenceBackend::RecordAdded);
+
+    backend->addOne(makeAppRecord(1));
+    QCOMPARE(added.size(), persistent ? 0 : 1);
+
+    backend->flush();
+    QCOMPARE(added.size(), 1);
+    QCOMPARE(added.first().first().value<NotificationRecord>().id, 1u);
+}
+
+void BackendsBenchmark::page_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::page()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(50));
+
+    QCOMPARE(ids(backend->getPage(3, QString(), true)), QStringList({ "50", "49", "48" }));
+    QCOMPARE(ids(backend->getPage(3, "48", true)), QStringList({ "47", "46", "45" }));
+    QCOMPARE(ids(backend->getPage(3, QString(), false)), QStringList({ "1", "2", "3" }));
+    QCOMPARE(ids(backend->getPage(3, "48", false)), QStringList({ "49", "50" }));
+    QCOMPARE(backend->getPage(-1, "10", false).size(), 40);
+
+    const NotificationRecordList records = backend->getById("7");
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records.first().summary, makeAppRecord(7).summary);
+    QCOMPARE(records.first().appName, makeAppRecord(7).appName);
+    QCOMPARE(records.first().timeout, -1);
+}
+
+void BackendsBenchmark::pageByTime_data()
+{
+    addBackendRows();
+}
+
+// the times are not in the order of the ids, as after a clock change or a migration
+void BackendsBenchmark::pageByTime()
+{
+    QScopedPointer<PersistenceBackend> backend(createBackend());
+    backend->open();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QList<qint64> offsets { 50, 10, 40, 20, 30, 20 };
+    for (int i = 0; i < offsets.size(); ++i) {
+        NotificationRecord record = makeAppRecord(i + 1);
+        record.ctime = now - 1000 + offsets.at(i);
+        backend->addOne(record);
+    }
+    backend->flush();
+
+    QCOMPARE(ids(backend->getAll()), QStringList({ "2", "4", "6", "5", "3", "1" }));
+    QCOMPARE(ids(backend->getPage(2, QString(), true)), QStringList({ "1", "3" }));
+    QCOMPARE(ids(backend->getPage(2, "3", true)), QStringList({ "5", "6" }));
+    QCOMPARE(ids(backend->getPage(2, "6", true)), QStringList({ "4", "2" }));
+    QCOMPARE(ids(backend->getPage(3, "4", false)), QStringList({ "6", "5", "3" }));
+
+    // the retention policy removes the oldest ones by time too
+    backend->setRetentionPolicy(3, 0, 0);
+    QTRY_COMPARE(ids(backend->getAll()), QStringList({ "5", "3", "1" }));
+}
+
+void BackendsBenchmark::remove_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::remove()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(10));
+
+    backend->removeOne("5");
+    QVERIFY(backend->getById("5").isEmpty());
+    QCOMPARE(ids(backend->getPage(2, "6", true)), QStringList({ "4", "3" }));
+
+    backend->removeAll();
+    QVERIFY(backend->getAll().isEmpty());
+
+    backend->addOne(makeAppRecord(11));
+    QCOMPARE(ids(backend->getAll()), QStringList({ "11" }));
+}
+
+void BackendsBenchmark::removeMany_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::removeMany()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(10));
+
+    // ids that do not exist are left out of the result
+    QCOMPARE(backend->removeMany({ "2", "3", "42" }), QStringList({ "2", "3" }));
+    QVERIFY(backend->getById("2").isEmpty());
+
+    // the odd ids are the records of deepin-terminal, 3 is gone already
+    QStringList removed = backend->removeByApp("deepin-terminal");
+    removed.sort();
+    QCOMPARE(removed, QStringList({ "1", "5", "7", "9" }));
+    QCOMPARE(ids(backend->getAll()), QStringList({ "4", "6", "8", "10" }));
+
+    QVERIFY(backend->removeByApp("deepin-terminal").isEmpty());
+    QVERIFY(backend->removeByApp("no such app").isEmpty());
+}
+
+void BackendsBenchmark::search_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::search()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(20));
+
+    QCOMPARE(ids(backend->search("summary 13", 10, 0)), QStringList({ "13" }));
+    QCOMPARE(backend->search("terminal", 100, 0).size(), 10);
+    QCOMPARE(backend->search("terminal", 100, 4).size(), 6);
+    QVERIFY(backend->search("nothing like this", 10, 0).isEmpty());
+}
+
+void BackendsBenchmark::retention_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::retention()
+{
+    QFETCH(bool, persistent);
+
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(30));
+    QSignalSpy expired(backend.data(), &PersistenceBackend::RecordsExpired);
+
+    backend->setRetentionPolicy(10, 0, 0);
+
+    // the SQLite backend removes expired records in the background, the others
+    // announce them once the removals are written
+    QTRY_COMPARE(backend->getAll().size(), 10);
+    QCOMPARE(ids(backend->getPage(1, QString(), false)), QStringList({ "21" }));
+    QTRY_VERIFY(!expired.isEmpty());
+
+    QStringList expiredIds;
+    for (const QList<QVariant> &arguments : expired) {
+        expiredIds << arguments.first().toStringList();
+    }
+    QCOMPARE(expiredIds.size(), 20);
+    QVERIFY(expiredIds.contains("1"));
+    QVERIFY(expiredIds.contains("20"));
+    QVERIFY(!expiredIds.contains("21"));
+
+    // the expired records do not come back
+    backend.reset();
+    backend.reset(createBackend());
+    backend->open();
+    QCOMPARE(backend->getAll().size(), persistent ? 10 : 0);
+}
+
+void BackendsBenchmark::changes_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::changes()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(5));
+
+    // the log starts with a Cleared change, so a new client gets all records from 0
+    NotificationChangeList changes = backend->changesSince(0, -1);
+    QCOMPARE(changes.size(), 6);
+    QCOMPARE(changes.first().operation, NotificationChange::Cleared);
+    QCOMPARE(changes.at(1).operation, NotificationChange::Added);
+    QCOMPARE(changes.at(1).record.summary, makeAppRecord(1).summary);
+    QCOMPARE(backend->changesSince(0, 2).size(), 2);
+
+    const qint64 seq = changes.last().seq;
+    QVERIFY(backend->changesSince(seq, -1).isEmpty());
+
+    backend->removeOne("2");
+    changes = backend->changesSince(seq, -1);
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().operation, NotificationChange::Removed);
+    QCOMPARE(changes.first().id, 2u);
+
+    // the addition of a removed record is still there, without the record
+    changes = backend->changesSince(0, -1);
+    QCOMPARE(changes.at(2).id, 2u);
+    QCOMPARE(changes.at(2).record.id, 0u);
+
+    // a seq that was never handed out
+    changes = backend->changesSince(seq + 100, -1);
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().operation, NotificationChange::Reset);
+
+    backend->removeAll();
+    changes = backend->changesSince(seq, -1);
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().operation, NotificationChange::Cleared);
+    QVERIFY(changes.first().seq > seq);
+}
+
+void BackendsBenchmark::benchmarkInsert_data()
+{
+    addBackendRows();
+}
+
+void BackendsBenchmark::benchmarkInsert()
+{
+    QScopedPointer<PersistenceBackend> backend(createBackend());
+    uint id = backend->open();
+
+    QBENCHMARK {
+        for (int i = 0; i < WorkloadSize; ++i) {
+            backend->addOne(makeAppRecord(++id));
+        }
+        backend->flush();
+    }
+}
+
+void BackendsBenchmark::benchmarkPage_data()
+{
+    addBackendRows();
+}
+
+// walking through all records page by page, the newest first
+void BackendsBenchmark::benchmarkPage()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(WorkloadSize));
+
+    QBENCHMARK {
+        int count = 0;
+        QString cursor;
+        for (;;) {
+            const NotificationRecordList records = backend->getPage(PageSize, cursor, true);
+            if (records.isEmpty())
+                break;
+
+            count += records.size();
+            cursor = QString::number(records.last().id);
+        }
+        QCOMPARE(count, WorkloadSize);
+    }
+}
+
+void BackendsBenchmark::benchmarkRemove_data()
+{
+    addBackendRows();
+}
+
+// removing all records one by one, the oldest first
+void BackendsBenchmark::benchmarkRemove()
+{
+    QScopedPointer<PersistenceBackend> backend(createFilledBackend(WorkloadSize));
+
+    QBENCHMARK_ONCE {
+        for (int i = 1; i <= WorkloadSize; ++i) {
+            backend->removeOne(QString::number(i));
+        }
+        backend->flush();
+    }
+
+    QVERIFY(backend->getAll().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(BackendsBenchmark)
+
+#include "bench_backends.moc"
@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    persistence \
+    backends \
+    encoding \
+    imagehint \
+    delayedreply
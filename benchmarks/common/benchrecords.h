@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHRECORDS_H
+#define BENCHRECORDS_H
+
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+
+#include "notificationrecord.h"
+
+// a record with a body of an ordinary length, as most notifications have
+inline NotificationRecord makeRecord(uint id, const QString &appName = QStringLiteral("deepin-notifications-benchmark"))
+{
+    NotificationRecord record;
+    record.id = id;
+    record.appName = appName;
+    record.appIcon = "deepin-notifications";
+    record.summary = QString("summary %1").arg(id);
+    record.body = QString("a notification body of an ordinary length, number %1").arg(id);
+    record.ctime = QDateTime::currentMSecsSinceEpoch();
+    record.replacesId = 0;
+    record.timeout = -1;
+
+    return record;
+}
+
+// the ids of the records, to compare them in checks
+inline QStringList ids(const NotificationRecordList &records)
+{
+    QStringList result;
+    for (const NotificationRecord &record : records) {
+        result << QString::number(record.id);
+    }
+
+    return result;
+}
+
+#endif // BENCHRECORDS_H
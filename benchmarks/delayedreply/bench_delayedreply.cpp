@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSemaphore>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+
+#include "notificationhistory.h"
+#include "notifications_dbus_adaptor.h"
+#include "notificationentity.h"
+#include "persistence.h"
+#include "benchrecords.h"
+
+static const QString HistoryPath = "/com/deepin/dde/Notification";
+static const QString HistoryInterface = "com.deepin.dde.Notification";
+static const int RecordCount = 10;
+
+// the history part of BubbleManager, owning its persistence as BubbleManager does
+class History : public NotificationHistory
+{
+public:
+    explicit History(const QString &backendName)
+    {
+        m_persistence = new Persistence(backendName, this);
+    }
+
+    Persistence *persistence() const { return m_persistence; }
+};
+
+// holds the thread it lives in once block() is called, until release() is
+class ThreadBlocker : public QObject
+{
+public:
+    // posted events are handled in order, so jobs posted after this one wait
+    void block() { QCoreApplication::postEvent(this, new QEvent(QEvent::User)); }
+    void release() { m_released.release(); }
+
+protected:
+    void customEvent(QEvent *) Q_DECL_OVERRIDE { m_released.tryAcquire(1, 5000); }
+
+private:
+    QSemaphore m_released;
+};
+
+// checks that the history methods do not keep the main loop waiting: calls from D-Bus
+// through DDENotifyDBus are answered once the persistence thread has the result,
+// calls from C++ still get the result.
+class DelayedReplyBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void delayedReply();
+    void delayedReplyWithOutArgument();
+    void typedReply();
+    void directCall();
+
+    void benchmarkCachedReply();
+
+private:
+    QDBusMessage call(const QString &method, const QVariantList &arguments = QVariantList());
+
+private:
+    QTemporaryDir m_dir;
+    History *m_history = nullptr;
+    ThreadBlocker *m_blocker = nullptr;
+    // calls to the own connection are delivered locally, without delayed replies
+    QDBusConnection m_client { QString() };
+};
+
+void DelayedReplyBenchmark::initTestCase()
+{
+    QDBusConnection service = QDBusConnection::sessionBus();
+    if (!service.isConnected())
+        QSKIP("no session bus");
+
+    QVERIFY(m_dir.isValid());
+    qputenv("XDG_DATA_HOME", m_dir.path().toLocal8Bit());
+
+    m_history = new History("memory");
+    new DDENotifyDBus(m_history);
+    QVERIFY(service.registerObject(HistoryPath, m_history));
+
+    for (int i = 1; i <= RecordCount; ++i) {
+        const NotificationRecord record = makeRecord(i);
+        NotificationEntity entity(record.appName, QString(), record.appIcon, record.summary, record.body,
+                                  QStringList(), QVariantMap(), QString::number(record.ctime),
+                                  QString::number(record.replacesId), QString::number(record.timeout));
+        m_history->persistence()->addOne(&entity);
+    }
+    m_history->persistence()->flush();
+
+    // its events are handled by the persistence thread in order with the jobs of the backend
+    m_blocker = new ThreadBlocker;
+    m_blocker->moveToThread(m_history->persistence()->findChild<QThread *>());
+
+    m_client = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "bench_delayedreply_client");
+    QVERIFY(m_client.isConnected());
+}
+
+void DelayedReplyBenchmark::cleanupTestCase()
+{
+    QDBusConnection::sessionBus().unregisterObject(HistoryPath);
+    QDBusConnection::disconnectFromBus("bench_delayedreply_client");
+    if (m_blocker)
+        m_blocker->deleteLater();
+    delete m_history;
+}
+
+QDBusMessage DelayedReplyBenchmark::call(const QString &method, const QVariantList &arguments)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(QDBusConnection::sessionBus().baseService(),
+                                                          HistoryPath, HistoryInterface, method);
+    message.setArguments(arguments);
+
+    return message;
+}
+
+void DelayedReplyBenchmark::delayedReply()
+{
+    m_blocker->block();
+
+    QDBusPendingCallWatcher watcher(m_client.asyncCall(call("GetAllRecords")));
+
+    // the call has been handled long ago, but the persistence thread has no result yet
+    QTest::qWait(200);
+    QVERIFY(!watcher.isFinished());
+
+    m_blocker->release();
+
+    QTRY_VERIFY(watcher.isFinished());
+    QDBusPendingReply<QString> reply = watcher;
+    QVERIFY2(!reply.isError(), qPrintable(reply.error().message()));
+    QCOMPARE(QJsonDocument::fromJson(reply.value().toUtf8()).array().size(), RecordCount);
+}
+
+void DelayedReplyBenchmark::delayedReplyWithOutArgument()
+{
+    m_blocker->block();
+
+    QDBusPendingCallWatcher watcher(m_client.asyncCall(call("SearchRecords", { "summary", 4, QString() })));
+    QTest::qWait(200);
+    QVERIFY(!watcher.isFinished());
+
+    m_blocker->release();
+
+    QTRY_VERIFY(watcher.isFinished());
+    QDBusPendingReply<QString, QString> reply = watcher;
+    QVERIFY2(!reply.isError(), qPrintable(reply.error().message()));
+    QCOMPARE(QJsonDocument::fromJson(reply.argumentAt<0>().toUtf8()).array().size(), 4);
+    QCOMPARE(reply.argumentAt<1>(), QString("4"));
+}
+
+void DelayedReplyBenchmark::typedReply()
+{
+    m_blocker->block();
+
+    QDBusPendingCallWatcher watcher(m_client.asyncCall(call("GetAllRecordsTyped")));
+    QTest::qWait(200);
+    QVERIFY(!watcher.isFinished());
+
+    m_blocker->release();
+
+    QTRY_VERIFY(watcher.isFinished());
+    QDBusPendingReply<NotificationRecordList> reply = watcher;
+    QVERIFY2(!reply.isError(), qPrintable(reply.error().message()));
+    QCOMPARE(reply.value().size(), RecordCount);
+    QCOMPARE(reply.value().first().id, 1u);
+}
+
+// not from D-Bus, the result is waited for
+void DelayedReplyBenchmark::directCall()
+{
+    QCOMPARE(m_history->GetAllRecordsTyped().size(), RecordCount);
+
+    QString nextCursor;
+    m_history->SearchRecords("summary", 4, QString(), nextCursor);
+    QCOMPARE(nextCursor, QString("4"));
+}
+
+// a round trip for a record in the cache of Persistence, the pages served by the cache
+// are ready futures, which is why the checks above use requests the backend answers
+void DelayedReplyBenchmark::benchmarkCachedReply()
+{
+    QBENCHMARK {
+        QDBusPendingCallWatcher watcher(m_client.asyncCall(call("GetRecordByIdTyped", { "1" })));
+        watcher.waitForFinished();
+        QCOMPARE(QDBusPendingReply<NotificationRecordList>(watcher).value().size(), 1);
+    }
+}
+
+QTEST_GUILESS_MAIN(DelayedReplyBenchmark)
+
+#include "bench_delayedreply.moc"
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+#include "notificationrecord.h"
+#include "benchrecords.h"
+
+static const int RecordCount = 10000;
+
+static const QString SourcePath = "/com/deepin/dde/Notification/Encoding";
+static const QString SourceInterface = "com.deepin.dde.Notification.Encoding";
+
+// answers like BubbleManager::GetAllRecordsTyped, so a client gets the records as they arrive
+class RecordSource : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.deepin.dde.Notification.Encoding")
+public:
+    NotificationRecordList records;
+
+public Q_SLOTS:
+    NotificationRecordList GetAllRecordsTyped() const { return records; }
+};
+
+// compares the two ways history records are sent over D-Bus:
+// the JSON strings of GetAllRecords and the (ussssxui) structures of GetAllRecordsTyped.
+class EncodingBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void encodeJson();
+    void decodeJson();
+    void marshallDBus();
+    void demarshallDBus();
+
+private:
+    NotificationRecordList m_records;
+    RecordSource m_source;
+    // calls to the own connection are delivered locally, without marshalling
+    QDBusConnection m_client { QString() };
+};
+
+void EncodingBenchmark::initTestCase()
+{
+    qDBusRegisterMetaType<NotificationRecord>();
+    qDBusRegisterMetaType<NotificationRecordList>();
+
+    for (int i = 1; i <= RecordCount; ++i) {
+        m_records << makeRecord(i);
+    }
+
+    QDBusConnection service = QDBusConnection::sessionBus();
+    if (service.isConnected()) {
+        m_source.records = m_records;
+        QVERIFY(service.registerObject(SourcePath, &m_source, QDBusConnection::ExportAllSlots));
+        m_client = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "bench_encoding_client");
+    }
+}
+
+void EncodingBenchmark::cleanupTestCase()
+{
+    QDBusConnection::sessionBus().unregisterObject(SourcePath);
+    QDBusConnection::disconnectFromBus("bench_encoding_client");
+}
+
+// what the service does for GetAllRecords
+void EncodingBenchmark::encodeJson()
+{
+    QBENCHMARK {
+        QJsonArray array;
+        for (const NotificationRecord &record : m_records) {
+            array.append(record.toJsonObject());
+        }
+        const QString json = QJsonDocument(array).toJson();
+        Q_UNUSED(json)
+    }
+}
+
+// what every client has to do with the result of GetAllRecords
+void EncodingBenchmark::decodeJson()
+{
+    QJsonArray array;
+    for (const NotificationRecord &record : m_records) {
+        array.append(record.toJsonObject());
+    }
+    const QString json = QJsonDocument(array).toJson();
+
+    QBENCHMARK {
+        const QJsonArray result = QJsonDocument::fromJson(json.toUtf8()).array();
+        QCOMPARE(result.size(), RecordCount);
+    }
+}
+
+// what the service does for GetAllRecordsTyped
+void EncodingBenchmark::marshallDBus()
+{
+    QBENCHMARK {
+        QDBusArgument argument;
+        argument << m_records;
+        QCOMPARE(argument.currentSignature(), QString("a(ussssxui)"));
+    }
+}
+
+// what every client has to do with the result of GetAllRecordsTyped
+void EncodingBenchmark::demarshallDBus()
+{
+    if (!m_client.isConnected())
+        QSKIP("no session bus");
+
+    QDBusPendingCallWatcher watcher(m_client.asyncCall(
+        QDBusMessage::createMethodCall(QDBusConnection::sessionBus().baseService(),
+                                       SourcePath, SourceInterface, "GetAllRecordsTyped")));
+    QTRY_VERIFY(watcher.isFinished());
+    QVERIFY(!watcher.isError());
+
+    const QVariant argument = watcher.reply().arguments().first();
+
+    QBENCHMARK {
+        // the copy is detached when it is read, so every run reads the reply from the start
+        NotificationRecordList records;
+        qvariant_cast<QDBusArgument>(argument) >> records;
+        QCOMPARE(records.size(), RecordCount);
+    }
+}
+
+QTEST_GUILESS_MAIN(EncodingBenchmark)
+
+#include "bench_encoding.moc"
@@ -0,0 +1,21 @@
+QT += testlib dbus
+QT -= gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_encoding
+
+SRC_DIR = $$PWD/../../src
+COMMON_DIR = $$PWD/../common
+INCLUDEPATH += $$SRC_DIR $$COMMON_DIR
+
+HEADERS += \
+    $$COMMON_DIR/benchrecords.h \
+    $$SRC_DIR/notificationentity.h \
+    $$SRC_DIR/notificationrecord.h
+
+SOURCES += \
+    bench_encoding.cpp \
+    $$SRC_DIR/notificationentity.cpp \
+    $$SRC_DIR/notificationrecord.cpp
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+
+#include "imagehint.h"
+
+typedef CopyLineFunction (*CopyLineGetter)(PixelKernel kernel);
+Q_DECLARE_METATYPE(PixelKernel)
+
+// the width of the longest line checked, the largest image-data hint accepted
+static const int MaxWidth = 2047;
+
+static QByteArray randomSamples(int count)
+{
+    QByteArray samples(count, Qt::Uninitialized);
+    for (int i = 0; i < count; ++i) {
+        // every value, including those above 127
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+        samples[i] = char(QRandomGenerator::global()->generate() & 0xff);
+#else
+        samples[i] = char(qrand() & 0xff);
+#endif
+    }
+
+    return samples;
+}
+
+// an image-data hint of size x size pixels, rowStride 0 means no padding
+static IconData makeHint(int size, int channels, int rowStride = 0)
+{
+    IconData data;
+    data.width = size;
+    data.height = size;
+    data.rowstride = rowStride > 0 ? rowStride : size * channels;
+    data.alpha = channels == 4;
+    data.bit = 8;
+    data.cannel = channels;
+    data.array = randomSamples(data.rowstride * size);
+
+    return data;
+}
+
+// The vector kernels converting image-data hints must give exactly the same pixels
+// as the scalar ones, the benchmarks compare them on icon sized to huge images.
+class ImageHintBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void kernels_data();
+    void kernels();
+
+    void decode();
+    void thumbnail();
+
+    void benchmarkCopyLine_data();
+    void benchmarkCopyLine();
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+    void benchmarkThumbnail_data();
+    void benchmarkThumbnail();
+
+private:
+    void addKernelRows(const QList<int> &sizes);
+};
+
+void ImageHintBenchmark::addKernelRows(const QList<int> &sizes)
+{
+    QTest::addColumn<PixelKernel>("kernel");
+    QTest::addColumn<int>("channels");
+    QTest::addColumn<int>("size");
+
+    const QList<QPair<const char *, PixelKernel>> kernels {
+        { "scalar", ScalarKernel },
+        { "sse2", SSE2Kernel },
+        { "ssse3", SSSE3Kernel },
+        { "avx2", AVX2Kernel },
+        { "best", BestKernel }
+    };
+
+    for (const auto &kernel : kernels) {
+        for (int channels : { 3, 4 }) {
+            for (int size : sizes) {
+                const QByteArray name = QString("%1 %2 %3px").arg(kernel.first, channels == 3 ? "rgb" : "rgba").arg(size).toLatin1();
+                QTest::newRow(name.constData()) << kernel.second << channels << size;
+            }
+        }
+    }
+}
+
+void ImageHintBenchmark::kernels_data()
+{
+    addKernelRows({ MaxWidth });
+}
+
+void ImageHintBenchmark::kernels()
+{
+    QFETCH(PixelKernel, kernel);
+    QFETCH(int, channels);
+
+    const CopyLineGetter getter = channels == 3 ? copyLineRGB32Function : copyLineARGB32Function;
+    const CopyLineFunction scalar = getter(ScalarKernel);
+    const CopyLineFunction function = getter(kernel);
+    if (!function)
+        QSKIP("not supported");
+
+    const QByteArray samples = randomSamples(MaxWidth * channels);
+    const uchar *src = reinterpret_cast<const uchar *>(samples.constData());
+
+    // every width around the vector sizes, with a guard pixel after the line
+    for (int width = 1; width <= MaxWidth; width += width < 80 ? 1 : 31) {
+        QVector<QRgb> expected(width + 1, 0x12345678);
+        QVector<QRgb> actual(width + 1, 0x12345678);
+
+        scalar(expected.data(), src, width);
+        function(actual.data(), src, width);
+
+        QCOMPARE(actual, expected);
+    }
+
+    QVector<QRgb> pixels(1);
+    const uchar bright[] = { 200, 150, 130, 255 };
+    function(pixels.data(), bright, 1);
+    QCOMPARE(pixels.first(), qRgba(200, 150, 130, channels == 3 ? 255 : bright[3]));
+}
+
+void ImageHintBenchmark::decode()
+{
+    // RGBA rows without padding are used as they are
+    const IconData shared = makeHint(64, 4);
+    const QImage sharedImage = decodeNotificationSpecImageHint(shared);
+    QCOMPARE(sharedImage.format(), QImage::Format_RGBA8888);
+    QCOMPARE(sharedImage.constBits(), reinterpret_cast<const uchar *>(shared.array.constData()));
+
+    // rows that are not 32 bit aligned are converted
+    IconData copied = makeHint(64, 4, 64 * 4 + 2);
+    for (int y = 0; y < 64; ++y) {
+        memcpy(copied.array.data() + y * copied.rowstride, shared.array.constData() + y * shared.rowstride, 64 * 4);
+    }
+    const QImage copiedImage = decodeNotificationSpecImageHint(copied);
+    QCOMPARE(copiedImage.format(), QImage::Format_ARGB32);
+
+    // the same pixels either way
+    QCOMPARE(sharedImage.convertToFormat(QImage::Format_ARGB32), copiedImage);
+
+    // the image keeps the pixels after the hint is gone
+    QImage kept;
+    {
+        const IconData hint = makeHint(16, 4);
+        kept = decodeNotificationSpecImageHint(hint);
+        QCOMPARE(kept.pixel(3, 5), qRgba(uchar(hint.array[(5 * 16 + 3) * 4]), uchar(hint.array[(5 * 16 + 3) * 4 + 1]),
+                                         uchar(hint.array[(5 * 16 + 3) * 4 + 2]), uchar(hint.array[(5 * 16 + 3) * 4 + 3])));
+    }
+    QCOMPARE(kept.size(), QSize(16, 16));
+    QVERIFY(!kept.copy().isNull());
+
+    // the last row is shorter than rowStride, as sent by gdk-pixbuf
+    IconData shortRow = makeHint(8, 4, 40);
+    shortRow.array.chop(8);
+    QCOMPARE(decodeNotificationSpecImageHint(shortRow).format(), QImage::Format_ARGB32);
+
+    QVERIFY(decodeNotificationSpecImageHint(makeHint(8, 2)).isNull());
+}
+
+void ImageHintBenchmark::thumbnail()
+{
+    const QSize iconSize(48, 48);
+
+    // a uniform, half transparent image keeps its color
+    IconData uniform = makeHint(1000, 4);
+    for (int i = 0; i < uniform.array.size(); i += 4) {
+        uniform.array[i] = char(200);
+        uniform.array[i + 1] = char(100);
+        uniform.array[i + 2] = char(50);
+        uniform.array[i + 3] = char(128);
+    }
+    QImage image = decodeNotificationSpecImageHint(uniform, iconSize);
+    QCOMPARE(image.size(), iconSize);
+    const QRgb pixel = image.convertToFormat(QImage::Format_ARGB32).pixel(20, 30);
+    QCOMPARE(qAlpha(pixel), 128);
+    QVERIFY(qAbs(qRed(pixel) - 200) <= 1 && qAbs(qGreen(pixel) - 100) <= 1 && qAbs(qBlue(pixel) - 50) <= 1);
+
+    // the aspect ratio is kept, the image covers the icon
+    image = decodeNotificationSpecImageHint(makeHint(300, 3), QSize(96, 48));
+    QCOMPARE(image.size(), QSize(96, 96));
+
+    // the same size as the smooth scaling of the full image
+    const IconData hint = makeHint(480, 3);
+    const QImage expected = decodeNotificationSpecImageHint(hint).scaled(iconSize, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    image = decodeNotificationSpecImageHint(hint, iconSize);
+    QCOMPARE(image.size(), expected.size());
+
+    // smaller images are scaled up after decoding
+    QCOMPARE(decodeNotificationSpecImageHint(makeHint(16, 4), iconSize).size(), iconSize);
+    QVERIFY(decodeNotificationSpecImageHint(makeHint(8, 2), iconSize).isNull());
+}
+
+void ImageHintBenchmark::benchmarkCopyLine_data()
+{
+    addKernelRows({ 48, 256, MaxWidth + 1 });
+}
+
+// a whole square image, one line after another
+void ImageHintBenchmark::benchmarkCopyLine()
+{
+    QFETCH(PixelKernel, kernel);
+    QFETCH(int, channels);
+    QFETCH(int, size);
+
+    const CopyLineFunction function = (channels == 3 ? copyLineRGB32Function : copyLineARGB32Function)(kernel);
+    if (!function)
+        QSKIP("not supported");
+
+    const QByteArray samples = randomSamples(size * size * channels);
+    QImage image(size, size, channels == 3 ? QImage::Format_RGB32 : QImage::Format_ARGB32);
+
+    QBENCHMARK {
+        const uchar *src = reinterpret_cast<const uchar *>(samples.constData());
+        for (int y = 0; y < size; ++y, src += size * channels) {
+            function(reinterpret_cast<QRgb *>(image.scanLine(y)), src, size);
+        }
+    }
+}
+
+void ImageHintBenchmark::benchmarkDecode_data()
+{
+    QTest::addColumn<int>("channels");
+    QTest::addColumn<int>("padding");
+    QTest::addColumn<int>("size");
+
+    for (int size : { 48, 256, MaxWidth }) {
+        QTest::newRow(qPrintable(QString("rgba %1px").arg(size))) << 4 << 0 << size;
+        QTest::newRow(qPrintable(QString("rgba padded %1px").arg(size))) << 4 << 2 << size;
+        QTest::newRow(qPrintable(QString("rgb %1px").arg(size))) << 3 << 0 << size;
+    }
+}
+
+// RGBA without padding is wrapped, the others are converted
+void ImageHintBenchmark::benchmarkDecode()
+{
+    QFETCH(int, channels);
+    QFETCH(int, padding);
+    QFETCH(int, size);
+
+    const IconData hint = makeHint(size, channels, padding > 0 ? size * channels + padding : 0);
+
+    QBENCHMARK {
+        const QImage image = decodeNotificationSpecImageHint(hint);
+        QCOMPARE(image.width(), size);
+    }
+}
+
+void ImageHintBenchmark::benchmarkThumbnail_data()
+{
+    QTest::addColumn<bool>("fused");
+    QTest::addColumn<int>("size");
+
+    for (int size : { 256, 1024, MaxWidth }) {
+        QTest::newRow(qPrintable(QString("decode and scale %1px").arg(size))) << false << size;
+        QTest::newRow(qPrintable(QString("fused %1px").arg(size))) << true << size;
+    }
+}
+
+// a 48x48 icon at a device pixel ratio of 2 from an RGBA hint, the way the bubble
+// did it before and with the box filter
+void ImageHintBenchmark::benchmarkThumbnail()
+{
+    QFETCH(bool, fused);
+    QFETCH(int, size);
+
+    const QSize iconSize(96, 96);
+    const IconData hint = makeHint(size, 4);
+
+    QBENCHMARK {
+        const QImage image = fused ? decodeNotificationSpecImageHint(hint, iconSize)
+                                   : decodeNotificationSpecImageHint(hint).scaled(iconSize, Qt::KeepAspectRatioByExpanding,
+                                                                                  Qt::SmoothTransformation);
+        QCOMPARE(image.size(), iconSize);
+    }
+}
+
+QTEST_APPLESS_MAIN(ImageHintBenchmark)
+
+#include "bench_imagehint.moc"
@@ -0,0 +1,18 @@
+QT += testlib dbus gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_imagehint
+
+SRC_DIR = $$PWD/../../src
+INCLUDEPATH += $$SRC_DIR
+
+HEADERS += \
+    $$SRC_DIR/imagehint.h \
+    $$SRC_DIR/icondata.h
+
+SOURCES += \
+    bench_imagehint.cpp \
+    $$SRC_DIR/imagehint.cpp \
+    $$SRC_DIR/icondata.cpp
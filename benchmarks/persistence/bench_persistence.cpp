@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+
+#include "sqlitebackend.h"
+#include "persistence.h"
+#include "notificationentity.h"
+#include "notificationrecord.h"
+#include "benchrecords.h"
+
+// what a CI or log watcher sends, repetitive text of some tens of KB
+static NotificationRecord makeLargeRecord(uint id)
+{
+    NotificationRecord record = makeRecord(id);
+
+    QString body;
+    for (int line = 0; body.size() < 32 * 1024; ++line) {
+        body += QString("[%1] step %2 of job %3 finished, 0 warnings\n").arg(line, 6).arg(line % 17).arg(id);
+    }
+    record.body = body;
+
+    return record;
+}
+
+static const int LargeRecordCount = 500;
+
+// records added or removed per iteration, and the history size for getAll and removeOne
+static const int WorkloadSize = 1000;
+static const int HistorySize = 10000;
+static const int PageSize = 20;
+
+class PersistenceBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void insertUnbatched();
+    void insertBatched();
+    void largeBodyStorage_data();
+    void largeBodyStorage();
+    void largeBodyRead_data();
+    void largeBodyRead();
+    void largeBodySearch();
+    void migrateLegacy();
+    void flushRetry();
+
+    // through Persistence, as BubbleManager uses it
+    void addOne();
+    void cachedPageByTime();
+    void getFrom_data();
+    void getFrom();
+    void getAll();
+    void removeOne();
+    void removeAll_data();
+    void removeAll();
+
+private:
+    QString databasePath() const;
+    void fillLargeRecords(int compressThreshold);
+    // a database with records 1 to count, written without going through the backend
+    void fillRecords(int count);
+
+private:
+    QTemporaryDir *m_dir = nullptr;
+};
+
+void PersistenceBenchmark::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+
+    // Persistence keeps its database in the data location, moved to the temporary directory
+    qputenv("XDG_DATA_HOME", m_dir->path().toLocal8Bit());
+    QVERIFY(QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)));
+}
+
+void PersistenceBenchmark::cleanup()
+{
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+QString PersistenceBenchmark::databasePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/data.db";
+}
+
+// what Persistence::addOne did per notification before statements were cached
+// and writes were batched: re-prepare, autocommit INSERT, then ask for the row id.
+void PersistenceBenchmark::insertUnbatched()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "benchmark");
+        db.setDatabaseName(databasePath());
+        QVERIFY(db.open());
+
+        // the table of that time, every column is text
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE notifications2 (ID INTEGER PRIMARY KEY AUTOINCREMENT, Icon TEXT, Summary TEXT,"
+                           "Body TEXT, AppName TEXT, CTime TEXT, ReplacesId TEXT, Timeout TEXT)"));
+
+        uint id = 0;
+
+        QBENCHMARK {
+            const NotificationRecord record = makeRecord(++id);
+
+            query.prepare("INSERT INTO notifications2 (Icon, Summary, Body, AppName, CTime, ReplacesId, Timeout)"
+                          "VALUES (:icon, :summary, :body, :appname, :ctime, :replacesid, :timeout)");
+            query.bindValue(":icon", record.appIcon);
+            query.bindValue(":summary", record.summary);
+            query.bindValue(":body", record.body);
+            query.bindValue(":appname", record.appName);
+            query.bindValue(":ctime", QString::number(record.ctime));
+            query.bindValue(":replacesid", QString::number(record.replacesId));
+            query.bindValue(":timeout", QString::number(record.timeout));
+            QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+
+            QVERIFY(query.exec("SELECT last_insert_rowid() FROM notifications2;"));
+            query.next();
+        }
+    }
+
+    QSqlDatabase::removeDatabase("benchmark");
+}
+
+// one record per iteration, the cost of the flushes is spread over the records they write
+void PersistenceBenchmark::insertBatched()
+{
+    SqliteBackend backend(databasePath());
+    uint id = backend.open();
+
+    QBENCHMARK {
+        backend.addOne(makeRecord(++id));
+    }
+
+    backend.flush();
+}
+
+void PersistenceBenchmark::fillLargeRecords(int compressThreshold)
+{
+    SqliteBackend backend(databasePath());
+    backend.open();
+    backend.setBodyCompression(compressThreshold);
+
+    for (int i = 1; i <= LargeRecordCount; ++i) {
+        backend.addOne(makeLargeRecord(i));
+    }
+}
+
+void PersistenceBenchmark::largeBodyStorage_data()
+{
+    QTest::addColumn<int>("compressThreshold");
+
+    QTest::newRow("plain") << 0;
+    QTest::newRow("compressed") << 4096;
+}
+
+// the size of the database file holding LargeRecordCount records
+void PersistenceBenchmark::largeBodyStorage()
+{
+    QFETCH(int, compressThreshold);
+
+    fillLargeRecords(compressThreshold);
+
+    QTest::setBenchmarkResult(QFileInfo(databasePath()).size(), QTest::BytesAllocated);
+}
+
+void PersistenceBenchmark::largeBodyRead_data()
+{
+    largeBodyStorage_data();
+}
+
+// reading every record back, including the decompression
+void PersistenceBenchmark::largeBodyRead()
+{
+    QFETCH(int, compressThreshold);
+
+    fillLargeRecords(compressThreshold);
+
+    SqliteBackend backend(databasePath());
+    backend.open();
+
+    const QString body = makeLargeRecord(1).body;
+
+    QBENCHMARK {
+        const NotificationRecordList records = backend.getAll();
+        QCOMPARE(records.size(), LargeRecordCount);
+        QCOMPARE(records.first().body, body);
+    }
+}
+
+static QStringList summaries(const NotificationRecordList &records)
+{
+    QStringList result;
+    for (const NotificationRecord &record : records) {
+        result << record.summary;
+    }
+
+    return result;
+}
+
+// only the prefix of a compressed body is searchable, the rest of it is not indexed
+void PersistenceBenchmark::largeBodySearch()
+{
+    SqliteBackend backend(databasePath());
+    backend.open();
+    backend.setBodyCompression(4096);
+
+    NotificationRecord record = makeLargeRecord(1);
+    record.body = "firstline\n" + record.body + "lastline\n";
+    backend.addOne(record);
+
+    QCOMPARE(backend.search("firstline", 10, 0).size(), 1);
+    QCOMPARE(backend.search("lastline", 10, 0).size(), 0);
+    QCOMPARE(backend.getById("1").first().body, record.body);
+
+    backend.setBodyCompression(0);
+    record.id = 2;
+    backend.addOne(record);
+
+    QCOMPARE(backend.search("lastline", 10, 0).size(), 1);
+}
+
+// the records of the first table version get their ids after those of notifications2,
+// they are older all the same, so they come last from the newest one and expire first.
+void PersistenceBenchmark::migrateLegacy()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "legacy");
+        db.setDatabaseName(databasePath());
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY2(query.exec("CREATE TABLE notifications (Icon TEXT, Summary TEXT, Body TEXT, AppName TEXT, CTime TEXT)"),
+                 qPrintable(query.lastError().text()));
+        QVERIFY2(query.exec("CREATE TABLE notifications2 (ID INTEGER PRIMARY KEY AUTOINCREMENT, Icon TEXT, Summary TEXT, "
+                            "Body TEXT, AppName TEXT, CTime TEXT, ReplacesId TEXT, Timeout TEXT)"),
+                 qPrintable(query.lastError().text()));
+
+        for (int i = 1; i <= 3; ++i) {
+            QVERIFY2(query.exec(QString("INSERT INTO notifications (Icon, Summary, Body, AppName, CTime) "
+                                        "VALUES ('deepin-notifications', 'legacy %1', 'body', 'deepin-notifications-benchmark', '%2')")
+                                .arg(i).arg(now - 2000 + i)),
+                     qPrintable(query.lastError().text()));
+            QVERIFY2(query.exec(QString("INSERT INTO notifications2 (Icon, Summary, Body, AppName, CTime, ReplacesId, Timeout) "
+                                        "VALUES ('deepin-notifications', 'v2 %1', 'body', 'deepin-notifications-benchmark', '%2', '0', '-1')")
+                                .arg(i).arg(now - 1000 + i)),
+                     qPrintable(query.lastError().text()));
+        }
+    }
+    QSqlDatabase::removeDatabase("legacy");
+
+    SqliteBackend backend(databasePath());
+
+    // 1 to 3 are kept by the records of notifications2, the legacy ones get 4 to 6
+    QCOMPARE(backend.open(), 6u);
+
+    QCOMPARE(summaries(backend.getPage(-1, QString(), true)),
+             QStringList({ "v2 3", "v2 2", "v2 1", "legacy 3", "legacy 2", "legacy 1" }));
+    QCOMPARE(summaries(backend.getPage(2, "1", true)), QStringList({ "legacy 3", "legacy 2" }));
+    QCOMPARE(summaries(backend.getPage(2, "6", false)), QStringList({ "v2 1", "v2 2" }));
+    QCOMPARE(summaries(backend.getAll()).first(), QString("legacy 1"));
+
+    // the legacy records are the oldest ones, the newer records are kept
+    backend.setRetentionPolicy(3, 0, 0);
+    QTRY_COMPARE(backend.getAll().size(), 3);
+    QCOMPARE(summaries(backend.getAll()), QStringList({ "v2 1", "v2 2", "v2 3" }));
+}
+
+// a batch that can not be written stays pending, it is given up after FlushRetries flushes
+void PersistenceBenchmark::flushRetry()
+{
+    qRegisterMetaType<NotificationRecord>();
+
+    SqliteBackend backend(databasePath());
+    backend.open();
+    QSignalSpy added(&backend, &PersistenceBackend::RecordAdded);
+    QSignalSpy lost(&backend, &PersistenceBackend::RecordsLost);
+
+    {
+        // fail right away instead of waiting for the lock
+        QSqlQuery query(QSqlDatabase::database("QSQLITE"));
+        QVERIFY2(query.exec("PRAGMA busy_timeout = 0"), qPrintable(query.lastError().text()));
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "lock");
+        db.setDatabaseName(databasePath());
+        QVERIFY(db.open());
+        QSqlQuery lock(db);
+
+        QVERIFY2(lock.exec("BEGIN EXCLUSIVE"), qPrintable(lock.lastError().text()));
+        backend.addOne(makeRecord(1));
+        backend.flush();
+        QVERIFY(added.isEmpty());
+        QVERIFY(lost.isEmpty());
+
+        // written by the next flush once the lock is gone
+        QVERIFY2(lock.exec("COMMIT"), qPrintable(lock.lastError().text()));
+        QTRY_COMPARE(added.size(), 1);
+
+        QVERIFY2(lock.exec("BEGIN EXCLUSIVE"), qPrintable(lock.lastError().text()));
+        backend.addOne(makeRecord(2));
+        for (int i = 0; i < FlushRetries; ++i) {
+            backend.flush();
+        }
+        QCOMPARE(added.size(), 1);
+        QCOMPARE(lost.size(), 1);
+        QCOMPARE(lost.first().first().toStringList(), QStringList({ "2" }));
+        QVERIFY2(lock.exec("COMMIT"), qPrintable(lock.lastError().text()));
+    }
+    QSqlDatabase::removeDatabase("lock");
+
+    QVERIFY(backend.getById("2").isEmpty());
+    QCOMPARE(backend.getAll().size(), 1);
+}
+
+void PersistenceBenchmark::fillRecords(int count)
+{
+    {
+        // only to create the tables
+        SqliteBackend backend(databasePath());
+        backend.open();
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fill");
+        db.setDatabaseName(databasePath());
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY2(query.exec("INSERT INTO apps (ID, Value) VALUES (1, 'deepin-notifications-benchmark')"), qPrintable(query.lastError().text()));
+        QVERIFY2(query.exec("INSERT INTO icons (ID, Value) VALUES (1, 'deepin-notifications')"), qPrintable(query.lastError().text()));
+
+        // a single statement, so even a million records only take seconds
+        QVERIFY2(query.exec(QString("WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n LIMIT %1) "
+                                    "INSERT INTO notifications4 (ID, IconId, Summary, Body, AppId, CTime, ReplacesId, Timeout) "
+                                    "SELECT x, 1, 'summary ' || x, 'a notification body of an ordinary length, number ' || x, "
+                                    "1, %2, 0, -1 FROM n")
+                             .arg(count).arg(QDateTime::currentMSecsSinceEpoch())),
+                 qPrintable(query.lastError().text()));
+    }
+
+    QSqlDatabase::removeDatabase("fill");
+}
+
+// including the flush of the records, one iteration adds WorkloadSize of them
+void PersistenceBenchmark::addOne()
+{
+    QList<NotificationEntity *> entities;
+    for (int i = 0; i < WorkloadSize; ++i) {
+        const NotificationRecord record = makeRecord(0);
+        entities << new NotificationEntity(record.appName, QString(), record.appIcon, record.summary, record.body,
+                                           QStringList(), QVariantMap(), QString::number(record.ctime),
+                                           QString::number(record.replacesId), QString::number(record.timeout));
+    }
+
+    {
+        Persistence persistence("sqlite");
+
+        QBENCHMARK {
+            for (NotificationEntity *entity : entities) {
+                persistence.addOne(entity);
+            }
+            persistence.flush();
+        }
+    }
+
+    qDeleteAll(entities);
+}
+
+void PersistenceBenchmark::getFrom_data()
+{
+    QTest::addColumn<int>("historySize");
+
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+// the pages served by the record cache are in the order of the backend,
+// also when the times are not in the order of the ids
+void PersistenceBenchmark::cachedPageByTime()
+{
+    Persistence persistence("sqlite");
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QList<qint64> offsets { 50, 10, 40, 20, 30, 20 };
+    for (qint64 offset : offsets) {
+        const NotificationRecord record = makeRecord(0);
+        NotificationEntity entity(record.appName, QString(), record.appIcon, record.summary, record.body,
+                                  QStringList(), QVariantMap(), QString::number(now - 1000 + offset),
+                                  QString::number(record.replacesId), QString::number(record.timeout));
+        persistence.addOne(&entity);
+    }
+    persistence.flush();
+
+    // the order of the backend, the same as in bench_backends
+    QCOMPARE(ids(persistence.getAllRecords().result()), QStringList({ "2", "4", "6", "5", "3", "1" }));
+
+    const int misses = persistence.cacheMisses();
+    QCOMPARE(ids(persistence.getRecordsPage(6, QString(), true).result()), QStringList({ "1", "3", "5", "6", "4", "2" }));
+    QCOMPARE(ids(persistence.getRecordsPage(2, "6", true).result()), QStringList({ "4", "2" }));
+    QCOMPARE(ids(persistence.getRecordsPage(3, "4", false).result()), QStringList({ "6", "5", "3" }));
+    QCOMPARE(persistence.cacheMisses(), misses);
+}
+
+// GetRecordsFromId, a page from the middle of the history
+void PersistenceBenchmark::getFrom()
+{
+    QFETCH(int, historySize);
+
+    fillRecords(historySize);
+
+    Persistence persistence("sqlite");
+    const QString offsetId = QString::number(historySize / 2);
+
+    QBENCHMARK {
+        const QString json = persistence.getPage(PageSize, offsetId, false).result();
+        QVERIFY(!json.isEmpty());
+    }
+}
+
+// GetAllRecords, the query and the JSON encoding
+void PersistenceBenchmark::getAll()
+{
+    fillRecords(HistorySize);
+
+    Persistence persistence("sqlite");
+
+    QBENCHMARK {
+        const QString json = persistence.getAll().result();
+        QVERIFY(!json.isEmpty());
+    }
+}
+
+// one iteration removes WorkloadSize records one by one
+void PersistenceBenchmark::removeOne()
+{
+    fillRecords(HistorySize);
+
+    Persistence persistence("sqlite");
+
+    QBENCHMARK_ONCE {
+        for (int i = 1; i <= WorkloadSize; ++i) {
+            persistence.removeOne(QString::number(i));
+        }
+        persistence.flush();
+    }
+}
+
+void PersistenceBenchmark::removeAll_data()
+{
+    QTest::addColumn<bool>("vacuum");
+
+    // the incremental vacuum steps run later in the persistence thread
+    QTest::newRow("incremental") << false;
+    // what ClearRecords did before
+    QTest::newRow("vacuum") << true;
+}
+
+void PersistenceBenchmark::removeAll()
+{
+    QFETCH(bool, vacuum);
+
+    fillRecords(100000);
+
+    Persistence persistence("sqlite");
+
+    QBENCHMARK_ONCE {
+        persistence.removeAll();
+        persistence.flush();
+
+        if (vacuum) {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "vacuum");
+            db.setDatabaseName(databasePath());
+            QVERIFY(db.open());
+            QSqlQuery query(db);
+            QVERIFY2(query.exec("VACUUM"), qPrintable(query.lastError().text()));
+        }
+    }
+
+    QSqlDatabase::removeDatabase("vacuum");
+}
+
+QTEST_GUILESS_MAIN(PersistenceBenchmark)
+
+#include "bench_persistence.moc"
@@ -0,0 +1,31 @@
+QT += testlib sql dbus
+QT -= gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_persistence
+
+SRC_DIR = $$PWD/../../src
+COMMON_DIR = $$PWD/../common
+INCLUDEPATH += $$SRC_DIR $$COMMON_DIR
+
+HEADERS += \
+    $$COMMON_DIR/benchrecords.h \
+    $$SRC_DIR/notificationentity.h \
+    $$SRC_DIR/notificationrecord.h \
+    $$SRC_DIR/persistence.h \
+    $$SRC_DIR/persistencebackend.h \
+    $$SRC_DIR/sqlitebackend.h \
+    $$SRC_DIR/memorybackend.h \
+    $$SRC_DIR/logbackend.h
+
+SOURCES += \
+    bench_persistence.cpp \
+    $$SRC_DIR/notificationentity.cpp \
+    $$SRC_DIR/notificationrecord.cpp \
+    $$SRC_DIR/persistence.cpp \
+    $$SRC_DIR/persistencebackend.cpp \
+    $$SRC_DIR/sqlitebackend.cpp \
+    $$SRC_DIR/memorybackend.cpp \
+    $$SRC_DIR/logbackend.cpp
@@ -25,46 +25,178 @@
 #include <QApplication>
 #include <QScreen>
 #include <QUrl>
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDebug>
 #include "appicon.h"
+#include "iconresolver.h"
 
+static const int IconCacheSize = 4 * 1024 * 1024;
+static const int DataIconCacheSize = 2 * 1024 * 1024;
+
+// keyed by the icon theme, the icon name or path, the size and the device pixel ratio
+static QCache<QString, QPixmap> IconCache(IconCacheSize);
+// the icons of data: URIs, keyed by a hash of the URI instead of the theme and the name
+static QCache<QString, QPixmap> DataIconCache(DataIconCacheSize);
+static QString IconCacheTheme;
+static int IconCacheHits = 0;
+static int IconCacheMisses = 0;
+
+static const QString PlaceholderIcon = ":/images/default.png";
+// every request for an icon gets a new one, so a late result is recognized
+static quint64 NextTicket = 0;
+
+// the pixmaps must go before the application
+static void clearIconCache()
+{
+    IconCache.clear();
+    DataIconCache.clear();
+}
+
+static IconResolver *iconResolver()
+{
+    static IconResolver *resolver = new IconResolver(qApp);
+    return resolver;
+}
+
+static bool isInlineIcon(const QString &iconPath)
+{
+    return iconPath.startsWith("data:image/");
+}
+
+// inline images are keyed by a hash, apps send the same one with every notification
+// and the key should not keep it alive.
+static QString iconKey(const QString &iconPath, const QString &theme, const QSize &size, qreal pixelRatio)
+{
+    if (isInlineIcon(iconPath)) {
+        const QByteArray hash = QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast<const char *>(iconPath.constData()),
+                                                                                 iconPath.size() * int(sizeof(QChar))),
+                                                         QCryptographicHash::Sha1);
+        return QString("%1\n%2x%3@%4").arg(QString::fromLatin1(hash.toHex())).arg(size.width()).arg(size.height()).arg(pixelRatio);
+    }
+
+    return QString("%1\n%2\n%3x%4@%5").arg(theme, iconPath).arg(size.width()).arg(size.height()).arg(pixelRatio);
+}
+
+static QPixmap scaledPixmap(const QPixmap &pixmap, const QSize &size, qreal pixelRatio)
+{
+    QPixmap scaled = pixmap.scaled(size * pixelRatio,
+                                   Qt::KeepAspectRatioByExpanding,
+                                   Qt::SmoothTransformation);
+    scaled.setDevicePixelRatio(pixelRatio);
+
+    return scaled;
+}
+
+// shown until the icon is resolved, it is loaded from the resources only once
+static QPixmap placeholder(const QSize &size, qreal pixelRatio)
+{
+    const QString key = iconKey(PlaceholderIcon, QString(), size, pixelRatio);
+    if (const QPixmap *cached = IconCache.object(key))
+        return *cached;
+
+    const QPixmap pixmap = scaledPixmap(QPixmap(PlaceholderIcon), size, pixelRatio);
+    IconCache.insert(key, new QPixmap(pixmap), pixmap.width() * pixmap.height() * pixmap.depth() / 8);
+
+    return pixmap;
+}
 
 AppIcon::AppIcon(QWidget *parent) :
-    QLabel(parent)
+    QLabel(parent),
+    m_ticket(0),
+    m_pendingRatio(1)
 {
     this->setAttribute(Qt::WA_TranslucentBackground);
     this->setAlignment(Qt::AlignCenter);
+
+    connect(iconResolver(), &IconResolver::resolved, this, &AppIcon::onIconResolved);
+
+    static bool cleanupAdded = false;
+    if (!cleanupAdded) {
+        qAddPostRoutine(clearIconCache);
+        cleanupAdded = true;
+    }
 }
 
 void AppIcon::setIcon(const QString &iconPath)
 {
     const qreal pixelRatio = qApp->primaryScreen()->devicePixelRatio();
-    QPixmap pixmap;
-
-    if (iconPath.startsWith("data:image/")){
-        // iconPath is a string representing an inline image.
-        QStringList strs = iconPath.split("base64,");
-        if (strs.length() == 2) {
-            QByteArray data = QByteArray::fromBase64(strs.at(1).toLatin1());
-            pixmap.loadFromData(data);
-        }
-    }
 
-    if (pixmap.isNull()) {
-        QString iconUrl;
-        const QUrl url(iconPath);
-        iconUrl = url.isLocalFile() ? url.toLocalFile() : url.url();
+    // a result still on its way belongs to the icon before
+    m_ticket = ++NextTicket;
 
-        const QIcon &icon = QIcon::fromTheme(iconPath, QIcon::fromTheme("application-x-desktop"));
-        pixmap = icon.pixmap(width() * pixelRatio, height() * pixelRatio);
+    // the pixmaps of another theme are not used again
+    const QString theme = QIcon::themeName();
+    if (theme != IconCacheTheme) {
+        IconCache.clear();
+        iconResolver()->clearThemes();
+        IconCacheTheme = theme;
     }
 
-    if (!pixmap.isNull()) {
-        pixmap = pixmap.scaled(width() * pixelRatio, height() * pixelRatio,
-                               Qt::KeepAspectRatioByExpanding,
-                               Qt::SmoothTransformation);
+    const QString key = iconKey(iconPath, theme, size(), pixelRatio);
+    QCache<QString, QPixmap> &cache = isInlineIcon(iconPath) ? DataIconCache : IconCache;
+    if (const QPixmap *cached = cache.object(key)) {
+        ++IconCacheHits;
+        // a null pixmap is an icon that was not found
+        QLabel::setPixmap(cached->isNull() ? placeholder(size(), pixelRatio) : *cached);
+        return;
+    }
+    ++IconCacheMisses;
+
+#ifdef QT_DEBUG
+    qDebug() << "icon cache hits:" << IconCacheHits << "misses:" << IconCacheMisses << "bytes:" << cacheBytes();
+#endif
+
+    // the bubble is shown with the placeholder right away, the icon comes later
+    QLabel::setPixmap(placeholder(size(), pixelRatio));
+
+    m_pendingPath = iconPath;
+    m_pendingKey = key;
+    m_pendingRatio = pixelRatio;
+    iconResolver()->resolve(m_ticket, iconPath, size() * pixelRatio, theme, QIcon::themeSearchPaths());
+}
+
+void AppIcon::setPixmap(const QPixmap &pixmap)
+{
+    m_ticket = ++NextTicket;
+
+    QLabel::setPixmap(pixmap);
+}
+
+void AppIcon::onIconResolved(quint64 ticket, const QImage &image)
+{
+    // the icon has been replaced since
+    if (ticket != m_ticket)
+        return;
+
+    QCache<QString, QPixmap> &cache = isInlineIcon(m_pendingPath) ? DataIconCache : IconCache;
 
-        pixmap.setDevicePixelRatio(pixelRatio);
+    // not even the generic icon was found, the placeholder stays. the miss is cached
+    // too, a themed icon is only looked for again once the icon theme changed.
+    if (image.isNull()) {
+        cache.insert(m_pendingKey, new QPixmap, 1);
+        return;
     }
 
-    setPixmap(pixmap);
+    QPixmap pixmap = QPixmap::fromImage(image);
+    pixmap.setDevicePixelRatio(m_pendingRatio);
+
+    cache.insert(m_pendingKey, new QPixmap(pixmap), pixmap.width() * pixmap.height() * pixmap.depth() / 8);
+
+    QLabel::setPixmap(pixmap);
+}
+
+int AppIcon::cacheHits()
+{
+    return IconCacheHits;
+}
+
+int AppIcon::cacheMisses()
+{
+    return IconCacheMisses;
+}
+
+int AppIcon::cacheBytes()
+{
+    return IconCache.totalCost() + DataIconCache.totalCost();
 }
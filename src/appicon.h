@@ -22,6 +22,7 @@
 
 #include <QLabel>
 #include <QPixmap>
+#include <QImage>
 
 class AppIcon : public QLabel
 {
@@ -29,7 +30,28 @@ class AppIcon : public QLabel
 public:
     explicit AppIcon(QWidget *parent = 0);
 
+    // the icon is resolved in another thread, a placeholder is shown until it is ready
     void setIcon(const QString &iconPath);
+    // replaces QLabel::setPixmap, so a late icon of setIcon() does not replace the pixmap
+    void setPixmap(const QPixmap &pixmap);
+
+    // the pixmaps of themed and file icons are shared by all AppIcons,
+    // the least recently used ones go once they take more than IconCacheSize bytes.
+    // the icons of data: URIs have a cache of their own, DataIconCacheSize bytes.
+    // icons that were not found are cached as well, so they are not looked for every time.
+    static int cacheHits();
+    static int cacheMisses();
+    static int cacheBytes();
+
+private Q_SLOTS:
+    void onIconResolved(quint64 ticket, const QImage &image);
+
+private:
+    // the request of the icon shown, or of the one being resolved
+    quint64 m_ticket;
+    QString m_pendingPath;
+    QString m_pendingKey;
+    qreal m_pendingRatio;
 };
 
 #endif // APPICON_H
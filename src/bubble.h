@@ -44,6 +44,8 @@ class QGraphicsDropShadowEffect;
 
 static const QStringList Directory = QStandardPaths::standardLocations(QStandardPaths::HomeLocation);
 static const QString CachePath = Directory.first() + "/.cache/deepin/deepin-notifications/";
+// image hints are decoded at this size, in device independent pixels
+static const QSize BubbleIconSize(48, 48);
 
 class Bubble : public DBlurEffectWidget
 {
@@ -85,9 +87,6 @@ private:
     void processIconData();
     bool containsMouse() const;
 
-    void saveImg(const QImage &image);
-    const QPixmap converToPixmap(const QDBusArgument &value);
-
 private:
     NotificationEntity *m_entity;
 
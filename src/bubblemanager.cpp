@@ -31,10 +31,16 @@
 #include "notificationentity.h"
 
 #include "persistence.h"
+#include "iconcachewriter.h"
+#include "icondata.h"
+#include "imagehint.h"
 
 #include <QTimer>
 #include <QDebug>
+#include <QFutureWatcher>
 #include <QXmlStreamReader>
+#include <QGSettings>
+#include <QScreen>
 
 static QString removeHTML(const QString &source) {
     QXmlStreamReader xml(source);
@@ -48,11 +54,54 @@ static QString removeHTML(const QString &source) {
     return textString.isEmpty() ? source : textString;
 }
 
+// the image hints in the order they are used, the newer name first
+static const QStringList ImageDataHints { "image-data", "icon_data" };
+
+// image hints hold up to 2047x2047 pixels, while the bubble only shows them as its icon.
+// the image is decoded at the size of the icon and all image hints are taken out of hints,
+// the one used is left in hint for the image cache, which keeps it at its full size.
+static QImage takeImageHint(QVariantMap &hints, IconData &hint)
+{
+    QImage image;
+
+    // like Bubble::processIconData, image-path wins over the pixels
+    bool wanted = hints.value("image-path").toString().isEmpty();
+    for (const QString &key : ImageDataHints) {
+        auto it = hints.find(key);
+        if (it == hints.end())
+            continue;
+
+        if (wanted && it.value().canConvert<QDBusArgument>()) {
+            it.value().value<QDBusArgument>() >> hint;
+
+            const qreal pixelRatio = qApp->primaryScreen()->devicePixelRatio();
+            image = decodeNotificationSpecImageHint(hint, BubbleIconSize * pixelRatio);
+            image.setDevicePixelRatio(pixelRatio);
+            wanted = false;
+        }
+
+        hints.erase(it);
+    }
+
+    return image;
+}
+
 BubbleManager::BubbleManager(QObject *parent)
-    : QObject(parent)
+    : NotificationHistory(parent)
 {
     m_bubble = new Bubble;
-    m_persistence = new Persistence;
+    m_iconCacheWriter = new IconCacheWriter(this);
+
+    m_batchRecordsAdded = DefaultBatchRecordsAdded;
+    m_recordsAddedTimer = new QTimer(this);
+    m_recordsAddedTimer->setInterval(RecordsAddedDelay);
+    m_recordsAddedTimer->setSingleShot(true);
+
+    // the key is optional like the ones of the retention policy
+    m_gsettings = new QGSettings("com.deepin.dde.notification", "/com/deepin/dde/notification/", this);
+    const QString backendName = m_gsettings->keys().contains("storageBackend")
+            ? m_gsettings->get("storage-backend").toString() : DefaultStorageBackend;
+    m_persistence = new Persistence(backendName, this);
     m_dockPosition = DockPosition::Bottom;
 
     m_dbusDaemonInterface = new DBusDaemonInterface(DBusDaemonDBusService, DBusDaemonDBusPath,
@@ -84,8 +133,17 @@ BubbleManager::BubbleManager(QObject *parent)
 
     connect(m_dbusdockinterface, &DBusDockInterface::geometryChanged, this, &BubbleManager::onDockRectChanged);
     connect(m_persistence, &Persistence::RecordAdded, this, &BubbleManager::onRecordAdded);
+    // the images of the records go with them, or the cache would grow without bound
+    connect(m_persistence, &Persistence::RecordsExpired, m_iconCacheWriter, &IconCacheWriter::remove);
+    connect(m_persistence, &Persistence::RecordsLost, this, &BubbleManager::onRecordsLost);
+    connect(m_recordsAddedTimer, &QTimer::timeout, this, &BubbleManager::emitRecordsAdded);
 
     connect(m_dockDeamonInter, &DockDaemonInter::PositionChanged, this, &BubbleManager::onDockPositionChanged);
+    connect(m_gsettings, &QGSettings::changed, this, &BubbleManager::applyRetentionPolicy);
+    connect(m_gsettings, &QGSettings::changed, this, &BubbleManager::applyRecordsAddedBatching);
+
+    applyRetentionPolicy();
+    applyRecordsAddedBatching();
 
     // get correct value for m_dockGeometry, m_dockPosition, m_ccGeometry
     if (m_dbusdockinterface->isValid())
@@ -100,7 +158,7 @@ BubbleManager::BubbleManager(QObject *parent)
 
 BubbleManager::~BubbleManager()
 {
-
+    m_persistence->flush();
 }
 
 void BubbleManager::CloseNotification(uint id)
@@ -138,12 +196,18 @@ uint BubbleManager::Notify(const QString &appName, uint replacesId,
              << "actions:" << actions << "hints:" << hints << "expireTimeout:" << expireTimeout;
 #endif
 
+    // the raw image is not kept while the notification waits in the queue
+    QVariantMap entityHints = hints;
+    IconData imageHint;
+    const QImage &image = takeImageHint(entityHints, imageHint);
+
     NotificationEntity *notification = new NotificationEntity(appName, QString(), appIcon,
-                                                              summary, removeHTML(body), actions, hints,
+                                                              summary, removeHTML(body), actions, entityHints,
                                                               QString::number(QDateTime::currentMSecsSinceEpoch()),
                                                               QString::number(replacesId),
                                                               QString::number(expireTimeout),
                                                               this);
+    notification->setImage(image);
 
     if (!m_currentNotify.isNull() && replacesId != 0 && (m_currentNotify->id() == QString::number(replacesId)
                                       || m_currentNotify->replacesId() == QString::number(replacesId))) {
@@ -153,10 +217,19 @@ uint BubbleManager::Notify(const QString &appName, uint replacesId,
         m_currentNotify = notification;
     } else {
         m_entities.enqueue(notification);
+
+#ifdef QT_DEBUG
+        qDebug() << "queued notifications:" << m_entities.size() << "bytes:" << queuedBytes();
+#endif
     }
 
     m_persistence->addOne(notification);
 
+    // the cache has the image at its full size, it is decoded again in the writer threads
+    if (!image.isNull()) {
+        m_iconCacheWriter->save(notification->id(), imageHint);
+    }
+
     if (!m_bubble->isVisible()) { consumeEntities(); }
 
     // If replaces_id is 0, the return value is a UINT32 that represent the notification.
@@ -164,52 +237,93 @@ uint BubbleManager::Notify(const QString &appName, uint replacesId,
     return replacesId == 0 ? notification->id().toUInt() : replacesId;
 }
 
-QString BubbleManager::GetAllRecords()
+qint64 BubbleManager::queuedBytes() const
 {
-    return m_persistence->getAll();
+    qint64 bytes = 0;
+    for (const NotificationEntity *entity : m_entities) {
+        bytes += entity->bytes();
+    }
+
+    return bytes;
 }
 
-QString BubbleManager::GetRecordById(const QString &id)
+void BubbleManager::RemoveRecord(const QString &id)
 {
-    return m_persistence->getById(id);
+    m_persistence->removeOne(id);
+    m_iconCacheWriter->remove(QStringList() << id);
 }
 
-QString BubbleManager::GetRecordsFromId(int rowCount, const QString &offsetId)
+void BubbleManager::RemoveRecords(const QStringList &ids)
 {
-    return m_persistence->getFrom(rowCount, offsetId);
+    onRecordsRemoved(m_persistence->removeMany(ids));
 }
 
-void BubbleManager::RemoveRecord(const QString &id)
+void BubbleManager::RemoveRecordsByApp(const QString &appName)
 {
-    m_persistence->removeOne(id);
-
-    QFile file(CachePath + id + ".png");
-    file.remove();
+    onRecordsRemoved(m_persistence->removeByApp(appName));
 }
 
 void BubbleManager::ClearRecords()
 {
     m_persistence->removeAll();
+    m_iconCacheWriter->removeAll();
+}
 
-    QDir dir(CachePath);
-    dir.removeRecursively();
+void BubbleManager::onRecordAdded(const NotificationRecord &record)
+{
+    if (!m_batchRecordsAdded) {
+        QJsonDocument doc(record.toJsonObject());
+        QString notify(doc.toJson(QJsonDocument::Compact));
+
+        Q_EMIT RecordAdded(notify);
+        Q_EMIT RecordAddedTyped(record);
+        return;
+    }
+
+    m_addedRecords << record;
+    if (m_addedRecords.size() >= RecordsAddedBatch) {
+        emitRecordsAdded();
+    } else if (!m_recordsAddedTimer->isActive()) {
+        m_recordsAddedTimer->start();
+    }
+}
+
+void BubbleManager::emitRecordsAdded()
+{
+    m_recordsAddedTimer->stop();
+
+    if (m_addedRecords.isEmpty())
+        return;
+
+    const NotificationRecordList records = m_addedRecords;
+    m_addedRecords.clear();
+
+    Q_EMIT RecordsAdded(NotificationRecord::toJson(records, QJsonDocument::Compact));
+    Q_EMIT RecordsAddedTyped(records);
 }
 
-void BubbleManager::onRecordAdded(NotificationEntity *entity)
+void BubbleManager::onRecordsLost(const QStringList &ids)
 {
-    QJsonObject notifyJson
-    {
-        {"name", entity->appName()},
-        {"icon", entity->appIcon()},
-        {"summary", entity->summary()},
-        {"body", entity->body()},
-        {"id", entity->id()},
-        {"time", entity->ctime()}
-    };
-    QJsonDocument doc(notifyJson);
-    QString notify(doc.toJson(QJsonDocument::Compact));
+    // clients may have got them from the cache already
+    m_iconCacheWriter->remove(ids);
+    Q_EMIT RecordsRemoved(ids);
+}
 
-    Q_EMIT RecordAdded(notify);
+void BubbleManager::onRecordsRemoved(const QFuture<QStringList> &future)
+{
+    // the ids are only known once the records are removed in the persistence thread
+    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [=] {
+        const QStringList ids = watcher->result();
+        watcher->deleteLater();
+
+        if (ids.isEmpty())
+            return;
+
+        m_iconCacheWriter->remove(ids);
+        Q_EMIT RecordsRemoved(ids);
+    });
+    watcher->setFuture(future);
 }
 
 void BubbleManager::registerAsService()
@@ -281,6 +395,9 @@ void BubbleManager::bubbleActionInvoked(uint id, QString actionId)
 
 void BubbleManager::onPrepareForSleep(bool sleep)
 {
+    // don't keep history in memory across suspend or quit
+    m_persistence->flush();
+
     // workaround to avoid the "About to suspend..." notifications still
     // hanging there on restoring from sleep confusing users.
     if (!sleep) {
@@ -433,3 +550,25 @@ void BubbleManager::consumeEntities()
     m_bubble->setBasePosition(getX(), getY(), pScreenWidget->geometry());
     m_bubble->setEntity(m_currentNotify);
 }
+
+void BubbleManager::applyRetentionPolicy()
+{
+    // the keys are optional, older schemas don't have them
+    const QStringList keys = m_gsettings->keys();
+    const int maxRecords = keys.contains("maxRecords") ? m_gsettings->get("max-records").toInt() : DefaultMaxRecords;
+    const int maxDays = keys.contains("maxRecordDays") ? m_gsettings->get("max-record-days").toInt() : DefaultMaxRecordDays;
+    const int maxSize = keys.contains("maxDatabaseSize") ? m_gsettings->get("max-database-size").toInt() : DefaultMaxDatabaseSize;
+
+    m_persistence->setRetentionPolicy(maxRecords, maxDays, qint64(maxSize) * 1024 * 1024);
+}
+
+void BubbleManager::applyRecordsAddedBatching()
+{
+    // optional like the keys of the retention policy
+    m_batchRecordsAdded = m_gsettings->keys().contains("batchRecordsAdded")
+            ? m_gsettings->get("batch-records-added").toBool() : DefaultBatchRecordsAdded;
+
+    // the records still waiting are not announced any other way
+    if (!m_batchRecordsAdded)
+        emitRecordsAdded();
+}
@@ -30,8 +30,11 @@
 #include <QDesktopWidget>
 #include <QApplication>
 #include <QGuiApplication>
+#include <QFuture>
 #include "bubble.h"
 #include "dbusdock_interface.h"
+#include "notificationrecord.h"
+#include "notificationhistory.h"
 #include <com_deepin_dde_daemon_dock.h>
 
 using DockDaemonInter =  com::deepin::dde::daemon::Dock;
@@ -51,13 +54,28 @@ static const QString Login1DBusPath = "/org/freedesktop/login1";
 static const QString DockDaemonDBusServie = "com.deepin.dde.daemon.Dock";
 static const QString DockDaemonDBusPath = "/com/deepin/dde/daemon/Dock";
 static const int ControlCenterWidth = 400;
+// default retention of the notification history, 0 means no limit. the history is only
+// limited once one of the gsettings keys is set, so an upgrade does not remove any of it.
+static const int DefaultMaxRecords = 0;
+static const int DefaultMaxRecordDays = 0;
+static const int DefaultMaxDatabaseSize = 0; // MB
+// with the optional gsettings key batch-records-added set, stored records are announced by
+// RecordsAdded instead of RecordAdded, when RecordsAddedBatch records are waiting, or
+// RecordsAddedDelay milliseconds after the first of them was added.
+static const bool DefaultBatchRecordsAdded = false;
+static const int RecordsAddedBatch = 64;
+static const int RecordsAddedDelay = 250;
+// one of the names known by PersistenceBackend::create, only read at startup
+static const QString DefaultStorageBackend = "sqlite";
 
 class DBusControlCenter;
 class DBusDaemonInterface;
 class Login1ManagerInterface;
 class DBusDockInterface;
 class Persistence;
-class BubbleManager : public QObject
+class QGSettings;
+class IconCacheWriter;
+class BubbleManager : public NotificationHistory
 {
     Q_OBJECT
 public:
@@ -78,13 +96,24 @@ public:
         Left = 3
     };
 
+    // the memory held by the notifications waiting to be shown, see NotificationEntity::bytes
+    qint64 queuedBytes() const;
+
 Q_SIGNALS:
     // Standard Notifications dbus implementation
     void ActionInvoked(uint, const QString &);
     void NotificationClosed(uint, uint);
 
     // Extra DBus APIs
+    // each stored record, unless they are batched
     void RecordAdded(const QString &);
+    void RecordAddedTyped(const NotificationRecord &);
+    // the stored records in batches, only if batch-records-added is set
+    void RecordsAdded(const QString &);
+    void RecordsAddedTyped(const NotificationRecordList &);
+    // once for every call of RemoveRecords or RemoveRecordsByApp, with the ids of the removed records,
+    // and with the ids of the records that could not be stored
+    void RecordsRemoved(const QStringList &);
 
 public Q_SLOTS:
     // Standard Notifications dbus implementation
@@ -95,14 +124,16 @@ public Q_SLOTS:
     uint Notify(const QString &, uint replacesId, const QString &, const QString &, const QString &, const QStringList &, const QVariantMap, int);
 
     // Extra DBus APIs
-    QString GetAllRecords();
-    QString GetRecordById(const QString &id);
-    QString GetRecordsFromId(int rowCount, const QString &offsetId);
     void RemoveRecord(const QString &id);
+    // each of them removes all records in a single transaction
+    void RemoveRecords(const QStringList &ids);
+    void RemoveRecordsByApp(const QString &appName);
     void ClearRecords();
 
 private Q_SLOTS:
-    void onRecordAdded(NotificationEntity *entity);
+    void onRecordAdded(const NotificationRecord &record);
+    void emitRecordsAdded();
+    void onRecordsLost(const QStringList &ids);
 
     void onCCDestRectChanged(const QRect &destRect);
     void onDockRectChanged(const QRect &geometry);
@@ -131,15 +162,23 @@ private:
 
     void bindControlCenterX();
     void consumeEntities();
+    void applyRetentionPolicy();
+    void applyRecordsAddedBatching();
+    void onRecordsRemoved(const QFuture<QStringList> &future);
 
 private:
     Bubble *m_bubble;
-    Persistence *m_persistence;
     DBusControlCenter *m_dbusControlCenter;
     DBusDaemonInterface *m_dbusDaemonInterface;
     Login1ManagerInterface *m_login1ManagerInterface;
     DBusDockInterface *m_dbusdockinterface;
     DockDaemonInter *m_dockDeamonInter;
+    QGSettings *m_gsettings;
+    IconCacheWriter *m_iconCacheWriter;
+
+    bool m_batchRecordsAdded;
+    NotificationRecordList m_addedRecords;
+    QTimer *m_recordsAddedTimer;
 
     QQueue<NotificationEntity*> m_entities;
     QPointer<NotificationEntity> m_currentNotify;
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DELAYEDREPLY_H
+#define DELAYEDREPLY_H
+
+#include <QObject>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QVariantList>
+
+// Sends the reply to message once future is finished, for slots that called
+// QDBusContext::setDelayedReply. reply makes the arguments of the reply from the result,
+// the out arguments after the return value. The reply is sent in the thread of receiver.
+//
+// QtDBus sets the context of a call on the object an adaptor belongs to, not on the
+// adaptor, so that object has to inherit QDBusContext itself, and directly: QtDBus finds
+// it by qt_metacast, which only knows the direct base classes.
+template <typename T, typename Reply>
+void replyWhenFinished(const QFuture<T> &future, const QDBusConnection &connection,
+                       const QDBusMessage &message, QObject *receiver, Reply reply)
+{
+    QFutureWatcher<T> *watcher = new QFutureWatcher<T>(receiver);
+    QObject::connect(watcher, &QFutureWatcherBase::finished, receiver, [=] {
+        connection.send(message.createReply(reply(watcher->result())));
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+}
+
+// the result is the only argument of the reply
+template <typename T>
+void replyWhenFinished(const QFuture<T> &future, const QDBusConnection &connection,
+                       const QDBusMessage &message, QObject *receiver)
+{
+    replyWhenFinished(future, connection, message, receiver, [](const T &result) {
+        return QVariantList { QVariant::fromValue(result) };
+    });
+}
+
+#endif // DELAYEDREPLY_H
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iconcachewriter.h"
+#include "runnablejob.h"
+#include "imagehint.h"
+#include "bubble.h"
+
+#include <QCryptographicHash>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// images are encoded by at most this many threads, and further ones are
+// dropped while this many are waiting, the cache is only a convenience.
+static const int WriterThreads = 2;
+static const int MaxPendingWrites = 64;
+
+static const QString ImagesDir = "images/";
+// the text key holding the name of the image in images/, so a removal finds it without a scan
+static const QString ImageHashKey = "Sha1";
+
+IconCacheWriter::IconCacheWriter(QObject *parent)
+    : QObject(parent)
+    , m_generation(0)
+{
+    m_pool.setMaxThreadCount(WriterThreads);
+}
+
+IconCacheWriter::~IconCacheWriter()
+{
+    m_pool.waitForDone();
+}
+
+void IconCacheWriter::save(const QString &id, const IconData &hint)
+{
+    int generation = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_pendingIds.size() >= MaxPendingWrites) {
+            qWarning() << "too many images waiting to be cached, drop the one of" << id;
+            return;
+        }
+
+        m_pendingIds.insert(id);
+        m_cancelledIds.remove(id);
+        generation = m_generation;
+    }
+
+    // the pixels are an implicitly shared QByteArray, so the copy is cheap
+    m_pool.start(new RunnableJob([=] { write(id, decodeNotificationSpecImageHint(hint), generation); }));
+}
+
+void IconCacheWriter::remove(const QStringList &ids)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &id : ids) {
+            if (m_pendingIds.contains(id)) {
+                m_cancelledIds.insert(id);
+            }
+        }
+    }
+
+    m_pool.start(new RunnableJob([=] {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &id : ids) {
+            const QString idPath = CachePath + id + ".png";
+
+            // only the text chunks before the pixels are read
+            const QString hash = QImageReader(idPath, "PNG").text(ImageHashKey);
+            QFile::remove(idPath);
+
+            if (!hash.isEmpty()) {
+                removeIfUnlinked(CachePath + ImagesDir + hash + ".png");
+            }
+        }
+    }));
+}
+
+void IconCacheWriter::removeAll()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_generation;
+        m_pendingIds.clear();
+        m_cancelledIds.clear();
+    }
+
+    m_pool.start(new RunnableJob([=] {
+        QMutexLocker locker(&m_mutex);
+        QDir(CachePath).removeRecursively();
+    }));
+}
+
+int IconCacheWriter::pendingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pendingIds.size();
+}
+
+void IconCacheWriter::write(const QString &id, const QImage &image, int generation)
+{
+    if (image.isNull()) {
+        QMutexLocker locker(&m_mutex);
+        if (generation == m_generation) {
+            m_pendingIds.remove(id);
+            m_cancelledIds.remove(id);
+        }
+        return;
+    }
+
+    const QString idPath = CachePath + id + ".png";
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(image.width()) + "x" + QByteArray::number(image.height())
+                 + "/" + QByteArray::number(image.format()));
+    for (int y = 0; y < image.height(); ++y) {
+        hash.addData(reinterpret_cast<const char *>(image.constScanLine(y)), image.bytesPerLine());
+    }
+    const QString hex = QString::fromLatin1(hash.result().toHex());
+    const QString imagePath = CachePath + ImagesDir + hex + ".png";
+
+    // the encoding is the slow part, it is skipped for an image written before
+    const QString tempPath = imagePath + "." + id;
+    const bool cached = QFile::exists(imagePath);
+    if (!cached) {
+        QDir().mkpath(CachePath + ImagesDir);
+        if (!saveImage(tempPath, image, hex)) {
+            qWarning() << "save image of" << id << "failed";
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const bool cancelled = generation != m_generation || m_cancelledIds.contains(id);
+    if (generation == m_generation) {
+        m_pendingIds.remove(id);
+        m_cancelledIds.remove(id);
+    }
+
+    if (cancelled) {
+        QFile::remove(tempPath);
+        return;
+    }
+
+    // removeUnlinkedImages() may have removed it since it was found
+    if (!QFile::exists(imagePath)) {
+        const bool saved = cached ? saveImage(imagePath, image, hex) : QFile::rename(tempPath, imagePath);
+        if (!saved) {
+            qWarning() << "save image of" << id << "failed";
+        }
+    }
+    QFile::remove(tempPath);
+
+    QFile::remove(idPath);
+    if (::link(QFile::encodeName(imagePath).constData(), QFile::encodeName(idPath).constData()) != 0) {
+        // a file system without hard links
+        QFile::copy(imagePath, idPath);
+    }
+
+#ifdef QT_DEBUG
+    qDebug() << "image of" << id << "cached, written before:" << cached;
+#endif
+}
+
+bool IconCacheWriter::saveImage(const QString &path, const QImage &image, const QString &hash)
+{
+    QImageWriter writer(path, "PNG");
+    writer.setText(ImageHashKey, hash);
+
+    return writer.write(image);
+}
+
+void IconCacheWriter::removeIfUnlinked(const QString &imagePath)
+{
+    // only the link in images/ is left
+    struct stat info;
+    if (::stat(QFile::encodeName(imagePath).constData(), &info) == 0 && info.st_nlink <= 1) {
+        QFile::remove(imagePath);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICONCACHEWRITER_H
+#define ICONCACHEWRITER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QImage>
+#include <QSet>
+
+#include "icondata.h"
+
+// Writes the images of the notifications to CachePath in a small thread pool, so the
+// decoding of the image hint at its full size and the PNG encoding never delay a bubble. Each distinct image is written once as
+// images/<sha1>.png, and <id>.png is a hard link to it, so readers still find it by id.
+// The PNG has the sha1 as text, so removing an id only looks at its own image.
+// Removals are ordered with the pending writes, a removed id is never written afterwards.
+class IconCacheWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IconCacheWriter(QObject *parent = 0);
+    ~IconCacheWriter();
+
+    // the image of an image-data or icon_data hint, nothing is written for an invalid one
+    void save(const QString &id, const IconData &hint);
+    void remove(const QStringList &ids);
+    void removeAll();
+
+    // the writes not finished yet
+    int pendingCount() const;
+
+private:
+    void write(const QString &id, const QImage &image, int generation);
+    // the PNG names hash, the name of the image in images/
+    static bool saveImage(const QString &path, const QImage &image, const QString &hash);
+    // remove the image in images/ if no id is linked to it any more, m_mutex must be locked
+    static void removeIfUnlinked(const QString &imagePath);
+
+private:
+    QThreadPool m_pool;
+
+    mutable QMutex m_mutex;
+    QSet<QString> m_pendingIds;
+    QSet<QString> m_cancelledIds;
+    // incremented by removeAll(), the writes of an earlier generation are dropped
+    int m_generation;
+};
+
+#endif // ICONCACHEWRITER_H
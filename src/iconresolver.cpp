@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iconresolver.h"
+#include "runnablejob.h"
+
+#include <QImageReader>
+#include <QSettings>
+#include <QFile>
+#include <QDir>
+#include <QUrl>
+#include <QSet>
+#include <QDebug>
+
+#include <limits>
+
+// icons are resolved by at most this many threads
+static const int ResolverThreads = 2;
+
+// in the order of preference of the icon theme spec
+static const QStringList IconExtensions { ".png", ".svg", ".xpm" };
+static const QString FallbackTheme = "hicolor";
+static const QString PixmapsPath = "/usr/share/pixmaps";
+// shown for an icon that is not found, like the fallback QIcon::fromTheme was given before
+static const QString FallbackIcon = "application-x-desktop";
+
+// scalable images are rendered right at the size they are needed
+static QImage readImage(const QString &path, const QSize &size)
+{
+    QImageReader reader(path);
+    const QByteArray format = reader.format();
+    if (format == "svg" || format == "svgz") {
+        const QSize imageSize = reader.size();
+        if (imageSize.isValid()) {
+            reader.setScaledSize(imageSize.scaled(size, Qt::KeepAspectRatioByExpanding));
+        }
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "read icon" << path << "failed:" << reader.errorString();
+    }
+
+    return image;
+}
+
+// the file of the icon in directory of any of the bases
+static QString findIconFile(const QStringList &bases, const QString &directory, const QString &name)
+{
+    for (const QString &base : bases) {
+        for (const QString &extension : IconExtensions) {
+            const QString path = base + "/" + directory + "/" + name + extension;
+            if (QFile::exists(path))
+                return path;
+        }
+    }
+
+    return QString();
+}
+
+IconResolver::IconResolver(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(ResolverThreads);
+}
+
+IconResolver::~IconResolver()
+{
+    m_pool.waitForDone();
+}
+
+void IconResolver::resolve(quint64 ticket, const QString &iconPath, const QSize &size,
+                           const QString &theme, const QStringList &searchPaths)
+{
+    m_pool.start(new RunnableJob([=] {
+        QImage image = load(iconPath, size, theme, searchPaths);
+        if (image.isNull()) {
+            image = load(FallbackIcon, size, theme, searchPaths);
+        }
+        if (!image.isNull() && image.size() != size) {
+            image = image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+        }
+
+        // queued to the thread of the receivers
+        Q_EMIT resolved(ticket, image);
+    }));
+}
+
+void IconResolver::clearThemes()
+{
+    QMutexLocker locker(&m_mutex);
+    m_themes.clear();
+}
+
+QImage IconResolver::load(const QString &iconPath, const QSize &size, const QString &theme, const QStringList &searchPaths)
+{
+    if (iconPath.startsWith("data:image/")) {
+        // iconPath is a string representing an inline image.
+        QImage image;
+        const int start = iconPath.indexOf("base64,");
+        if (start != -1) {
+            image.loadFromData(QByteArray::fromBase64(iconPath.midRef(start + 7).toLatin1()));
+        }
+        return image;
+    }
+
+    if (iconPath.startsWith("file://"))
+        return readImage(QUrl(iconPath).toLocalFile(), size);
+
+    if (QDir::isAbsolutePath(iconPath))
+        return readImage(iconPath, size);
+
+    const QString path = findIcon(iconPath, qMax(size.width(), size.height()), theme, searchPaths);
+    if (path.isEmpty())
+        return QImage();
+
+    return readImage(path, size);
+}
+
+QString IconResolver::findIcon(const QString &name, int size, const QString &theme, const QStringList &searchPaths)
+{
+    // the themes the icon is looked for in, the inherited ones after the theme that inherits them
+    QStringList themes { theme };
+    QSet<QString> visited;
+    QList<IconTheme> chain;
+    while (!themes.isEmpty()) {
+        const QString themeName = themes.takeFirst();
+        if (themeName.isEmpty() || visited.contains(themeName))
+            continue;
+        visited.insert(themeName);
+
+        const IconTheme iconTheme = this->iconTheme(themeName, searchPaths);
+        chain << iconTheme;
+        themes << iconTheme.inherits;
+        if (themes.isEmpty() && !visited.contains(FallbackTheme)) {
+            themes << FallbackTheme;
+        }
+    }
+
+    // like QIcon::fromTheme, "a-b-c" falls back to "a-b" and then to "a"
+    QString iconName = name;
+    for (;;) {
+        for (const IconTheme &iconTheme : chain) {
+            const QString path = findThemeIcon(iconName, size, iconTheme);
+            if (!path.isEmpty())
+                return path;
+        }
+
+        const int dash = iconName.lastIndexOf('-');
+        if (dash <= 0)
+            break;
+        iconName.truncate(dash);
+    }
+
+    // icons that are not in any theme
+    return findIconFile(searchPaths + QStringList(PixmapsPath), QString("."), name);
+}
+
+QString IconResolver::findThemeIcon(const QString &name, int size, const IconTheme &theme)
+{
+    // a directory matching the size, or else the one closest to it
+    QString closestPath;
+    int closestDistance = std::numeric_limits<int>::max();
+
+    for (const ThemeDirectory &directory : theme.directories) {
+        int distance = 0;
+        switch (directory.type) {
+        case ThemeDirectory::Fixed:
+            distance = qAbs(directory.size - size);
+            break;
+        case ThemeDirectory::Scalable:
+            distance = size < directory.minSize ? directory.minSize - size : qMax(0, size - directory.maxSize);
+            break;
+        case ThemeDirectory::Threshold:
+            distance = size < directory.size - directory.threshold ? directory.size - directory.threshold - size
+                                                                    : qMax(0, size - directory.size - directory.threshold);
+            break;
+        }
+
+        if (distance >= closestDistance)
+            continue;
+
+        const QString path = findIconFile(theme.bases, directory.path, name);
+        if (path.isEmpty())
+            continue;
+
+        if (distance == 0)
+            return path;
+
+        closestPath = path;
+        closestDistance = distance;
+    }
+
+    return closestPath;
+}
+
+IconResolver::IconTheme IconResolver::iconTheme(const QString &name, const QStringList &searchPaths)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_themes.constFind(name);
+        if (it != m_themes.constEnd())
+            return it.value();
+    }
+
+    IconTheme theme;
+    QString indexPath;
+    for (const QString &searchPath : searchPaths) {
+        const QString base = searchPath + "/" + name;
+        if (!QDir(base).exists())
+            continue;
+
+        theme.bases << base;
+        if (indexPath.isEmpty() && QFile::exists(base + "/index.theme")) {
+            indexPath = base + "/index.theme";
+        }
+    }
+
+    if (!indexPath.isEmpty()) {
+        const QSettings index(indexPath, QSettings::IniFormat);
+        theme.inherits = index.value("Icon Theme/Inherits").toStringList();
+
+        for (const QString &path : index.value("Icon Theme/Directories").toStringList()) {
+            const int scale = qMax(1, index.value(path + "/Scale", 1).toInt());
+
+            ThemeDirectory directory;
+            directory.path = path;
+            directory.size = index.value(path + "/Size").toInt() * scale;
+            directory.minSize = index.value(path + "/MinSize", directory.size / scale).toInt() * scale;
+            directory.maxSize = index.value(path + "/MaxSize", directory.size / scale).toInt() * scale;
+            directory.threshold = index.value(path + "/Threshold", 2).toInt() * scale;
+
+            const QString type = index.value(path + "/Type", "Threshold").toString();
+            directory.type = type == "Fixed" ? ThemeDirectory::Fixed
+                                             : type == "Scalable" ? ThemeDirectory::Scalable : ThemeDirectory::Threshold;
+
+            if (directory.size > 0) {
+                theme.directories << directory;
+            }
+        }
+    }
+
+#ifdef QT_DEBUG
+    qDebug() << "icon theme" << name << "read, directories:" << theme.directories.size();
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    m_themes.insert(name, theme);
+
+    return theme;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICONRESOLVER_H
+#define ICONRESOLVER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QHash>
+#include <QImage>
+#include <QStringList>
+
+// Finds and decodes the images of icons in a thread pool, so a bubble never waits
+// for the icon theme or the disk. Icon names are looked up in the theme by the rules
+// of the freedesktop icon theme spec, the index of each theme is only read once.
+class IconResolver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IconResolver(QObject *parent = 0);
+    ~IconResolver();
+
+    // iconPath is a data: URI, a file path or URL, or an icon name of theme.
+    // resolved() is emitted with ticket and the image scaled to cover size, the
+    // generic application icon if the icon is not found, a null image if neither is.
+    void resolve(quint64 ticket, const QString &iconPath, const QSize &size,
+                 const QString &theme, const QStringList &searchPaths);
+
+    // forget the themes read so far, after the icon theme changed
+    void clearThemes();
+
+Q_SIGNALS:
+    void resolved(quint64 ticket, const QImage &image);
+
+private:
+    // a directory of icons of a theme, the sizes are in pixels
+    struct ThemeDirectory {
+        enum Type {
+            Fixed,
+            Scalable,
+            Threshold
+        };
+
+        QString path;
+        Type type;
+        int size;
+        int minSize;
+        int maxSize;
+        int threshold;
+    };
+
+    struct IconTheme {
+        // the directories of the theme in all search paths
+        QStringList bases;
+        QList<ThemeDirectory> directories;
+        QStringList inherits;
+    };
+
+    QImage load(const QString &iconPath, const QSize &size, const QString &theme, const QStringList &searchPaths);
+    QString findIcon(const QString &name, int size, const QString &theme, const QStringList &searchPaths);
+    QString findThemeIcon(const QString &name, int size, const IconTheme &theme);
+    // the theme read from the search paths, m_mutex must not be locked
+    IconTheme iconTheme(const QString &name, const QStringList &searchPaths);
+
+private:
+    QThreadPool m_pool;
+
+    QMutex m_mutex;
+    QHash<QString, IconTheme> m_themes;
+};
+
+#endif // ICONRESOLVER_H
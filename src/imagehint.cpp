@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "imagehint.h"
+
+#include <QDebug>
+#include <QVector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// the vector kernels are built for their own instruction sets with the target
+// attribute, the rest of the program does not need any of them.
+#define IMAGEHINT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// the samples are unsigned, going through char would sign-extend those above 127
+static void copyLineRGB32_scalar(QRgb *dst, const uchar *src, int width)
+{
+    const uchar *end = src + width * 3;
+    for (; src != end; ++dst, src += 3) {
+        *dst = qRgb(src[0], src[1], src[2]);
+    }
+}
+
+static void copyLineARGB32_scalar(QRgb *dst, const uchar *src, int width)
+{
+    const uchar *end = src + width * 4;
+    for (; src != end; ++dst, src += 4) {
+        *dst = qRgba(src[0], src[1], src[2], src[3]);
+    }
+}
+
+#ifdef IMAGEHINT_X86_KERNELS
+
+// QRgb is B, G, R, A in memory, so RGBA only needs R and B to trade places.
+// SSE2 has no byte shuffle, the two bytes are moved by shifting them within each pixel.
+__attribute__((target("sse2")))
+static void copyLineARGB32_sse2(QRgb *dst, const uchar *src, int width)
+{
+    const __m128i redBlue = _mm_set1_epi32(0x00ff00ff);
+    const __m128i greenAlpha = _mm_set1_epi32(int(0xff00ff00));
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        const __m128i rb = _mm_and_si128(pixels, redBlue);
+        const __m128i br = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_or_si128(_mm_and_si128(pixels, greenAlpha), br));
+    }
+
+    copyLineARGB32_scalar(dst + x, src + x * 4, width - x);
+}
+
+// 4 pixels of RGB are 12 bytes, the loop stops while 16 bytes can still be loaded
+__attribute__((target("ssse3")))
+static void copyLineRGB32_ssse3(QRgb *dst, const uchar *src, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+
+    copyLineRGB32_scalar(dst + x, src + x * 3, width - x);
+}
+
+__attribute__((target("ssse3")))
+static void copyLineARGB32_ssse3(QRgb *dst, const uchar *src, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_shuffle_epi8(pixels, shuffle));
+    }
+
+    copyLineARGB32_scalar(dst + x, src + x * 4, width - x);
+}
+
+// vpshufb shuffles within 128 bit lanes, so each lane gets 4 pixels of its own:
+// the second load starts at byte 12 and reads up to byte 28.
+__attribute__((target("avx2")))
+static void copyLineRGB32_avx2(QRgb *dst, const uchar *src, int width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                             2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+
+    int x = 0;
+    for (; x + 10 <= width; x += 8) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3 + 12));
+        const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+    }
+
+    copyLineRGB32_scalar(dst + x, src + x * 3, width - x);
+}
+
+__attribute__((target("avx2")))
+static void copyLineARGB32_avx2(QRgb *dst, const uchar *src, int width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+
+    copyLineARGB32_scalar(dst + x, src + x * 4, width - x);
+}
+
+#endif // IMAGEHINT_X86_KERNELS
+
+static bool kernelSupported(PixelKernel kernel)
+{
+    switch (kernel) {
+    case ScalarKernel:
+        return true;
+#ifdef IMAGEHINT_X86_KERNELS
+    case SSE2Kernel:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case SSSE3Kernel:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    case AVX2Kernel:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+// the kernels from the slowest to the fastest, 0 for the ones that do not exist
+static CopyLineFunction copyLineFunction(PixelKernel kernel, const CopyLineFunction (&functions)[BestKernel])
+{
+    if (kernel != BestKernel)
+        return kernelSupported(kernel) ? functions[kernel] : 0;
+
+    for (int i = BestKernel - 1; i > ScalarKernel; --i) {
+        if (functions[i] && kernelSupported(PixelKernel(i)))
+            return functions[i];
+    }
+
+    return functions[ScalarKernel];
+}
+
+CopyLineFunction copyLineRGB32Function(PixelKernel kernel)
+{
+#ifdef IMAGEHINT_X86_KERNELS
+    static const CopyLineFunction functions[BestKernel] = {
+        copyLineRGB32_scalar, 0, copyLineRGB32_ssse3, copyLineRGB32_avx2
+    };
+#else
+    static const CopyLineFunction functions[BestKernel] = { copyLineRGB32_scalar, 0, 0, 0 };
+#endif
+
+    if (kernel == BestKernel) {
+        static const CopyLineFunction best = copyLineFunction(BestKernel, functions);
+        return best;
+    }
+
+    return copyLineFunction(kernel, functions);
+}
+
+CopyLineFunction copyLineARGB32Function(PixelKernel kernel)
+{
+#ifdef IMAGEHINT_X86_KERNELS
+    static const CopyLineFunction functions[BestKernel] = {
+        copyLineARGB32_scalar, copyLineARGB32_sse2, copyLineARGB32_ssse3, copyLineARGB32_avx2
+    };
+#else
+    static const CopyLineFunction functions[BestKernel] = { copyLineARGB32_scalar, 0, 0, 0 };
+#endif
+
+    if (kernel == BestKernel) {
+        static const CopyLineFunction best = copyLineFunction(BestKernel, functions);
+        return best;
+    }
+
+    return copyLineFunction(kernel, functions);
+}
+
+static bool checkHint(const IconData &data)
+{
+    #define SANITY_CHECK(condition) \
+    if (!(condition)) { \
+        qWarning() << "Sanity check failed on" << #condition; \
+        return false; \
+    }
+
+    SANITY_CHECK(data.width > 0);
+    SANITY_CHECK(data.width < 2048);
+    SANITY_CHECK(data.height > 0);
+    SANITY_CHECK(data.height < 2048);
+    SANITY_CHECK(data.rowstride > 0);
+
+    #undef SANITY_CHECK
+
+    return true;
+}
+
+static inline uint div255(uint x)
+{
+    return (x + (x >> 8) + 0x80) >> 8;
+}
+
+// add the pixels of a source row to the sums of the output columns, premultiplied.
+// output column x covers the source columns from columns[x] to columns[x + 1].
+template <int Channels>
+static void accumulateRow(quint32 *sums, const uchar *src, const int *columns, int outWidth)
+{
+    for (int x = 0; x < outWidth; ++x, sums += 4) {
+        const uchar *end = src + (columns[x + 1] - columns[x]) * Channels;
+        for (; src != end; src += Channels) {
+            if (Channels == 4) {
+                const uint alpha = src[3];
+                sums[0] += div255(src[0] * alpha);
+                sums[1] += div255(src[1] * alpha);
+                sums[2] += div255(src[2] * alpha);
+                sums[3] += alpha;
+            } else {
+                sums[0] += src[0];
+                sums[1] += src[1];
+                sums[2] += src[2];
+            }
+        }
+    }
+}
+
+// an area averaging box filter straight from the samples, every output pixel is
+// the mean of the source pixels it covers. size must not be larger than the hint.
+static QImage downscaleHint(const IconData &data, const QSize &size)
+{
+    const int outWidth = size.width();
+    const int outHeight = size.height();
+    const bool hasAlpha = data.cannel == 4;
+
+    QImage image(size, hasAlpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+    QVector<int> columns(outWidth + 1);
+    for (int x = 0; x <= outWidth; ++x) {
+        columns[x] = int(qint64(x) * data.width / outWidth);
+    }
+
+    // the largest sum is 2047 * 2047 * 255, it fits
+    QVector<quint32> sums(outWidth * 4);
+    const uchar *pixels = reinterpret_cast<const uchar *>(data.array.constData());
+
+    int y = 0;
+    for (int outY = 0; outY < outHeight; ++outY) {
+        const int yEnd = int(qint64(outY + 1) * data.height / outHeight);
+        const int rows = yEnd - y;
+
+        sums.fill(0);
+        for (; y < yEnd; ++y) {
+            const uchar *src = pixels + qint64(y) * data.rowstride;
+            if (hasAlpha) {
+                accumulateRow<4>(sums.data(), src, columns.constData(), outWidth);
+            } else {
+                accumulateRow<3>(sums.data(), src, columns.constData(), outWidth);
+            }
+        }
+
+        QRgb *dst = reinterpret_cast<QRgb *>(image.scanLine(outY));
+        const quint32 *sum = sums.constData();
+        for (int x = 0; x < outWidth; ++x, sum += 4) {
+            const quint32 area = quint32(rows) * quint32(columns[x + 1] - columns[x]);
+            const quint32 half = area / 2;
+            if (hasAlpha) {
+                dst[x] = qRgba((sum[0] + half) / area, (sum[1] + half) / area,
+                               (sum[2] + half) / area, (sum[3] + half) / area);
+            } else {
+                dst[x] = qRgb((sum[0] + half) / area, (sum[1] + half) / area, (sum[2] + half) / area);
+            }
+        }
+    }
+
+    return image;
+}
+
+// keeps the pixels of an image that does not copy them
+static void releasePixels(void *pixels)
+{
+    delete static_cast<QByteArray *>(pixels);
+}
+
+QImage decodeNotificationSpecImageHint(const QDBusArgument &arg)
+{
+    IconData data;
+    arg >> data;
+
+    return decodeNotificationSpecImageHint(data);
+}
+
+QImage decodeNotificationSpecImageHint(const IconData &data)
+{
+    const int width = data.width;
+    const int height = data.height;
+    const int rowStride = data.rowstride;
+    const int bitsPerSample = data.bit;
+    const int channels = data.cannel;
+    const QByteArray &pixels = data.array;
+    const uchar *ptr;
+    const uchar *end;
+
+    if (!checkHint(data))
+        return QImage();
+
+    // the samples are already in the layout of Format_RGBA8888. QImage needs every row
+    // 32 bit aligned, and all rows complete, as it may copy height * rowStride bytes.
+    if (bitsPerSample == 8 && channels == 4 && data.alpha
+            && rowStride % 4 == 0 && rowStride >= width * 4
+            && qint64(rowStride) * height <= pixels.size()
+            && quintptr(pixels.constData()) % 4 == 0) {
+        return QImage(reinterpret_cast<const uchar *>(pixels.constData()), width, height, rowStride,
+                      QImage::Format_RGBA8888, releasePixels, new QByteArray(pixels));
+    }
+
+    QImage::Format format = QImage::Format_Invalid;
+    CopyLineFunction fcn = 0;
+    if (bitsPerSample == 8) {
+        if (channels == 4) {
+            format = QImage::Format_ARGB32;
+            fcn = copyLineARGB32Function();
+        } else if (channels == 3) {
+            format = QImage::Format_RGB32;
+            fcn = copyLineRGB32Function();
+        }
+    }
+    if (format == QImage::Format_Invalid) {
+        qWarning() << "Unsupported image format (hasAlpha:" << data.alpha << "bitsPerSample:" << bitsPerSample << "channels:" << channels << ")";
+        return QImage();
+    }
+
+    QImage image(width, height, format);
+    ptr = reinterpret_cast<const uchar *>(pixels.constData());
+    end = ptr + pixels.length();
+    for (int y=0; y<height; ++y, ptr += rowStride) {
+        if (ptr + channels * width > end) {
+            qWarning() << "Image data is incomplete. y:" << y << "height:" << height;
+            break;
+        }
+        fcn((QRgb*)image.scanLine(y), ptr, width);
+    }
+
+    return image;
+}
+
+QImage decodeNotificationSpecImageHint(const IconData &data, const QSize &size)
+{
+    if (!checkHint(data))
+        return QImage();
+
+    const QSize scaledSize = QSize(data.width, data.height).scaled(size, Qt::KeepAspectRatioByExpanding);
+
+    // only smaller images are made while decoding, and only from complete samples
+    const bool downscale = data.bit == 8 && (data.cannel == 3 || data.cannel == 4)
+            && !scaledSize.isEmpty() && scaledSize.width() < data.width && scaledSize.height() < data.height
+            && data.rowstride >= data.width * data.cannel
+            && qint64(data.rowstride) * (data.height - 1) + data.width * data.cannel <= data.array.size();
+
+    if (downscale)
+        return downscaleHint(data, scaledSize);
+
+    const QImage image = decodeNotificationSpecImageHint(data);
+    if (image.isNull() || image.size() == scaledSize)
+        return image;
+
+    return image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+}
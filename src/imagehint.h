@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEHINT_H
+#define IMAGEHINT_H
+
+#include <QImage>
+#include <QDBusArgument>
+
+#include "icondata.h"
+
+// converts width pixels of 8 bit samples to QRgb, the source is RGB for
+// copyLineRGB32 and RGBA for copyLineARGB32.
+typedef void (*CopyLineFunction)(QRgb *dst, const uchar *src, int width);
+
+enum PixelKernel {
+    ScalarKernel,
+    SSE2Kernel,
+    SSSE3Kernel,
+    AVX2Kernel,
+    // the fastest one the cpu supports, chosen once at runtime
+    BestKernel
+};
+
+// 0 if the kernel is not built in, or the cpu does not support it
+CopyLineFunction copyLineRGB32Function(PixelKernel kernel = BestKernel);
+CopyLineFunction copyLineARGB32Function(PixelKernel kernel = BestKernel);
+
+// the image of an image-data or icon_data hint of the notification spec,
+// a null image if the hint is not valid.
+QImage decodeNotificationSpecImageHint(const QDBusArgument &arg);
+// RGBA pixels with 32 bit aligned rows are not copied, the image shares data.array
+QImage decodeNotificationSpecImageHint(const IconData &data);
+// the image scaled to cover size, keeping its aspect ratio. larger images are
+// averaged down while they are decoded, without the full sized image in between.
+QImage decodeNotificationSpecImageHint(const IconData &data, const QSize &size);
+
+#endif // IMAGEHINT_H
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logbackend.h"
+
+#include <QDataStream>
+#include <QSaveFile>
+#include <QTimer>
+#include <QDebug>
+
+static const quint32 LogMagic = 0x444e4c47; // "DNLG"
+static const quint32 LogVersion = 1;
+
+// the file is compacted when it has CompactFactor times more entries than there
+// are records, and at least CompactMinimum entries.
+static const int CompactFactor = 2;
+static const int CompactMinimum = 1000;
+
+static void writeRecord(QDataStream &stream, const NotificationRecord &record)
+{
+    stream << record.id << record.appName << record.appIcon << record.summary << record.body
+           << record.ctime << record.replacesId << qint32(record.timeout);
+}
+
+static void readRecord(QDataStream &stream, NotificationRecord &record)
+{
+    qint32 timeout = 0;
+    stream >> record.id >> record.appName >> record.appIcon >> record.summary >> record.body
+           >> record.ctime >> record.replacesId >> timeout;
+    record.timeout = timeout;
+}
+
+LogBackend::LogBackend(const QString &logPath, QObject *parent)
+    : MemoryBackend(parent)
+    , m_logPath(logPath)
+    , m_file(logPath)
+    , m_pendingCount(0)
+    , m_entryCount(0)
+    , m_flushTimer(new QTimer(this))
+{
+    m_flushTimer->setInterval(FlushDelay);
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &LogBackend::flush);
+}
+
+LogBackend::~LogBackend()
+{
+    flush();
+}
+
+uint LogBackend::open()
+{
+    if (!replay()) {
+        // a new file, or one that can not be read anyway
+        compact();
+    } else if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qWarning() << "open log" << m_logPath << "failed:" << m_file.errorString();
+    }
+
+    // the change log is not written to the file, it starts again with the replayed records
+    resetChangeLog();
+
+    return m_lastId;
+}
+
+void LogBackend::removeOne(const QString &id)
+{
+    MemoryBackend::removeOne(id);
+
+    appendRemove(QStringList() << id);
+}
+
+QStringList LogBackend::removeMany(const QStringList &ids)
+{
+    const QStringList removed = MemoryBackend::removeMany(ids);
+
+    appendRemove(removed);
+
+    return removed;
+}
+
+QStringList LogBackend::removeByApp(const QString &appName)
+{
+    // MemoryBackend::removeByApp() goes through removeMany(), which writes the log
+    return MemoryBackend::removeByApp(appName);
+}
+
+void LogBackend::removeAll()
+{
+    // the pending records are announced before they are removed, like in SqliteBackend
+    flush();
+
+    MemoryBackend::removeAll();
+
+    // nothing before is needed any more
+    compact();
+}
+
+void LogBackend::flush()
+{
+    m_flushTimer->stop();
+
+    if (m_pendingEntries.isEmpty())
+        return;
+
+    if (m_file.write(m_pendingEntries) != m_pendingEntries.size() || !m_file.flush()) {
+        qWarning() << "write log" << m_logPath << "failed:" << m_file.errorString();
+    }
+
+    m_entryCount += m_pendingCount;
+    m_pendingEntries.clear();
+    m_pendingCount = 0;
+
+    if (m_entryCount >= CompactMinimum && m_entryCount > CompactFactor * m_records.size()) {
+        compact();
+    }
+
+    const QList<NotificationRecord> added = m_pendingAdded;
+    const QStringList expired = m_pendingExpired;
+    m_pendingAdded.clear();
+    m_pendingExpired.clear();
+
+    for (const NotificationRecord &record : added) {
+        emit RecordAdded(record);
+    }
+
+    if (!expired.isEmpty()) {
+        emit RecordsExpired(expired);
+    }
+}
+
+void LogBackend::commitAdded(const NotificationRecord &record)
+{
+    QByteArray entry;
+    QDataStream stream(&entry, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint8(Add);
+    writeRecord(stream, record);
+
+    m_pendingAdded << record;
+    append(entry);
+}
+
+void LogBackend::commitExpired(const QStringList &ids)
+{
+    // replaying the log must not bring them back
+    m_pendingExpired << ids;
+    appendRemove(ids);
+}
+
+bool LogBackend::replay()
+{
+    QFile file(m_logPath);
+    if (!file.exists())
+        return false;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "read log" << m_logPath << "failed:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != LogMagic || version != LogVersion) {
+        qWarning() << "unknown log format" << m_logPath;
+        return false;
+    }
+
+    qint64 validSize = file.pos();
+    while (!stream.atEnd()) {
+        quint8 operation = 0;
+        stream >> operation;
+
+        NotificationRecord record;
+        uint id = 0;
+
+        switch (operation) {
+        case Add:
+            readRecord(stream, record);
+            break;
+        case Remove:
+        case LastId:
+            stream >> id;
+            break;
+        default:
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+
+        // a session that ended while writing leaves an incomplete entry behind
+        if (stream.status() != QDataStream::Ok)
+            break;
+
+        switch (operation) {
+        case Add:
+            insertRecord(record);
+            break;
+        case Remove:
+            removeRecord(id);
+            break;
+        case LastId:
+            m_lastId = qMax(m_lastId, id);
+            break;
+        }
+
+        validSize = file.pos();
+        ++m_entryCount;
+    }
+
+    file.close();
+
+    if (validSize < file.size()) {
+        qWarning() << "drop the incomplete end of log" << m_logPath;
+        file.resize(validSize);
+    }
+
+    return true;
+}
+
+void LogBackend::appendRemove(const QStringList &ids)
+{
+    if (ids.isEmpty())
+        return;
+
+    QByteArray entries;
+    QDataStream stream(&entries, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    for (const QString &id : ids) {
+        stream << quint8(Remove) << id.toUInt();
+    }
+
+    append(entries, ids.size());
+}
+
+void LogBackend::append(const QByteArray &entries, int count)
+{
+    m_pendingEntries += entries;
+    m_pendingCount += count;
+
+    if (m_pendingCount >= FlushThreshold) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void LogBackend::compact()
+{
+    // written to a new file which replaces the old one, a crash leaves either of them complete
+    QSaveFile file(m_logPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "compact log" << m_logPath << "failed:" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    // ids are never used again, even those of records that are gone
+    stream << LogMagic << LogVersion << quint8(LastId) << m_lastId;
+    for (const NotificationRecord &record : m_records) {
+        stream << quint8(Add);
+        writeRecord(stream, record);
+    }
+
+    m_file.close();
+
+    if (!file.commit()) {
+        qWarning() << "compact log" << m_logPath << "failed:" << file.errorString();
+    }
+
+    m_entryCount = m_records.size() + 1;
+
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qWarning() << "open log" << m_logPath << "failed:" << m_file.errorString();
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOGBACKEND_H
+#define LOGBACKEND_H
+
+#include <QFile>
+
+#include "memorybackend.h"
+
+class QDataStream;
+
+// Keeps the records in memory and appends every change to a log file, which is
+// replayed by open(). Writes are cheap, and the file is rewritten with only the
+// remaining records once most of it is outdated.
+class LogBackend : public MemoryBackend
+{
+    Q_OBJECT
+public:
+    explicit LogBackend(const QString &logPath, QObject *parent = 0);
+    ~LogBackend();
+
+    uint open() Q_DECL_OVERRIDE;
+
+    // the change is only written to the file by the next flush, which happens
+    // when enough changes are pending or after a short delay. RecordAdded and
+    // RecordsExpired are emitted once the flush wrote the entries.
+    void removeOne(const QString &id) Q_DECL_OVERRIDE;
+    QStringList removeMany(const QStringList &ids) Q_DECL_OVERRIDE;
+    QStringList removeByApp(const QString &appName) Q_DECL_OVERRIDE;
+    void removeAll() Q_DECL_OVERRIDE;
+    void flush() Q_DECL_OVERRIDE;
+
+protected:
+    void commitAdded(const NotificationRecord &record) Q_DECL_OVERRIDE;
+    void commitExpired(const QStringList &ids) Q_DECL_OVERRIDE;
+
+private:
+    enum Operation {
+        Add = 1,
+        Remove = 2,
+        LastId = 3
+    };
+
+    // return false if the file is not a log
+    bool replay();
+    void appendRemove(const QStringList &ids);
+    // count is the number of entries in entries, which are written by the same flush
+    void append(const QByteArray &entries, int count = 1);
+    void compact();
+
+private:
+    QString m_logPath;
+    QFile m_file;
+
+    QByteArray m_pendingEntries;
+    int m_pendingCount;
+    // announced by the next flush
+    QList<NotificationRecord> m_pendingAdded;
+    QStringList m_pendingExpired;
+    // the entries in the file, compared with the number of records to decide when to compact it
+    int m_entryCount;
+    QTimer *m_flushTimer;
+};
+
+#endif // LOGBACKEND_H
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memorybackend.h"
+
+#include <QTimer>
+#include <QDateTime>
+#include <QStringList>
+
+#include <limits>
+
+// a rough estimate of the memory used by a record
+static qint64 recordSize(const NotificationRecord &record)
+{
+    const int characters = record.appName.size() + record.appIcon.size() + record.summary.size() + record.body.size();
+    return qint64(characters) * int(sizeof(QChar)) + int(sizeof(NotificationRecord));
+}
+
+MemoryBackend::MemoryBackend(QObject *parent)
+    : PersistenceBackend(parent)
+    , m_lastId(0)
+    , m_size(0)
+    , m_lastSeq(QDateTime::currentMSecsSinceEpoch())
+    , m_maxCount(0)
+    , m_maxDays(0)
+    , m_maxSize(0)
+    , m_retentionTimer(new QTimer(this))
+{
+    m_retentionTimer->setInterval(RetentionCheckInterval);
+    connect(m_retentionTimer, &QTimer::timeout, this, &MemoryBackend::enforceRetention);
+
+    resetChangeLog();
+}
+
+uint MemoryBackend::open()
+{
+    return m_lastId;
+}
+
+void MemoryBackend::setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize)
+{
+    m_maxCount = maxCount;
+    m_maxDays = maxDays;
+    m_maxSize = maxSize;
+
+    if (m_maxDays > 0) {
+        m_retentionTimer->start();
+    } else {
+        m_retentionTimer->stop();
+    }
+
+    enforceRetention();
+}
+
+void MemoryBackend::addOne(const NotificationRecord &record)
+{
+    insertRecord(record);
+    logChange(NotificationChange::Added, record.id);
+
+    commitAdded(record);
+
+    // removing the oldest records is cheap here, so it is done right away
+    if ((m_maxCount > 0 && m_records.size() > m_maxCount) || (m_maxSize > 0 && m_size > m_maxSize)) {
+        enforceRetention();
+    }
+}
+
+void MemoryBackend::removeOne(const QString &id)
+{
+    if (removeRecord(id.toUInt())) {
+        logChange(NotificationChange::Removed, id.toUInt());
+    }
+}
+
+QStringList MemoryBackend::removeMany(const QStringList &ids)
+{
+    QStringList removed;
+    for (const QString &id : ids) {
+        if (removeRecord(id.toUInt())) {
+            logChange(NotificationChange::Removed, id.toUInt());
+            removed << id;
+        }
+    }
+
+    return removed;
+}
+
+QStringList MemoryBackend::removeByApp(const QString &appName)
+{
+    QStringList ids;
+    for (const NotificationRecord &record : m_records) {
+        if (record.appName == appName) {
+            ids << QString::number(record.id);
+        }
+    }
+
+    return removeMany(ids);
+}
+
+void MemoryBackend::removeAll()
+{
+    clearRecords();
+    resetChangeLog();
+}
+
+void MemoryBackend::flush()
+{
+}
+
+NotificationRecordList MemoryBackend::getAll()
+{
+    NotificationRecordList records;
+    for (uint id : m_order) {
+        records << m_records.value(id);
+    }
+
+    return records;
+}
+
+NotificationRecordList MemoryBackend::getById(const QString &id)
+{
+    NotificationRecordList records;
+
+    bool ok = false;
+    auto it = m_records.constFind(id.toUInt(&ok));
+    if (ok && it != m_records.constEnd()) {
+        records << it.value();
+    }
+
+    return records;
+}
+
+NotificationRecordList MemoryBackend::getPage(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    NotificationRecordList records;
+
+    const uint count = rowCount < 0 ? std::numeric_limits<uint>::max() : uint(rowCount);
+    const QMap<RecordOrder, uint> &order = m_order;
+
+    if (newestFirst) {
+        auto it = cursorId.isEmpty() ? order.end() : order.lowerBound(cursorOrder(cursorId));
+        while (uint(records.size()) < count && it != order.begin()) {
+            --it;
+            records << m_records.value(it.value());
+        }
+    } else {
+        auto it = cursorId.isEmpty() ? order.begin() : order.upperBound(cursorOrder(cursorId));
+        for (; it != order.end() && uint(records.size()) < count; ++it) {
+            records << m_records.value(it.value());
+        }
+    }
+
+    return records;
+}
+
+RecordOrder MemoryBackend::cursorOrder(const QString &cursorId) const
+{
+    // the time of the cursor, or of the record before it by id if it has been removed since
+    const uint cursor = cursorId.toUInt();
+    qint64 ctime = std::numeric_limits<qint64>::min();
+
+    auto it = m_records.upperBound(cursor);
+    if (it != m_records.begin()) {
+        --it;
+        ctime = it.value().ctime;
+    }
+
+    return RecordOrder(ctime, cursor);
+}
+
+NotificationRecordList MemoryBackend::search(const QString &text, int limit, int offset)
+{
+    NotificationRecordList records;
+
+    const QStringList words = searchWords(text);
+    if (words.isEmpty())
+        return records;
+
+    int skipped = 0;
+    auto it = m_order.constEnd();
+    while (records.size() < limit && it != m_order.constBegin()) {
+        --it;
+        const NotificationRecord &record = m_records.constFind(it.value()).value();
+
+        bool matched = true;
+        for (const QString &word : words) {
+            if (!record.summary.contains(word, Qt::CaseInsensitive)
+                    && !record.body.contains(word, Qt::CaseInsensitive)
+                    && !record.appName.contains(word, Qt::CaseInsensitive)) {
+                matched = false;
+                break;
+            }
+        }
+
+        if (!matched)
+            continue;
+
+        if (skipped < offset) {
+            ++skipped;
+        } else {
+            records << record;
+        }
+    }
+
+    return records;
+}
+
+NotificationChangeList MemoryBackend::changesSince(qint64 seq, int limit)
+{
+    NotificationChangeList changes;
+
+    if (!logCovers(seq, m_changes.value(0), m_lastSeq)) {
+        changes << NotificationChange(m_lastSeq, NotificationChange::Reset);
+        return changes;
+    }
+
+    if (m_changes.isEmpty())
+        return changes;
+
+    // the seqs in the log have no gaps
+    const int count = limit < 0 ? m_changes.size() : limit;
+    for (int i = qMax(0, int(seq + 1 - m_changes.first().seq)); i < m_changes.size() && changes.size() < count; ++i) {
+        NotificationChange change = m_changes.at(i);
+        if (change.operation == NotificationChange::Added) {
+            change.record = m_records.value(change.id);
+        }
+        changes << change;
+    }
+
+    return changes;
+}
+
+void MemoryBackend::insertRecord(const NotificationRecord &record)
+{
+    auto it = m_records.find(record.id);
+    if (it != m_records.end()) {
+        m_size -= recordSize(it.value());
+        m_order.remove(it.value().order());
+    }
+
+    m_records.insert(record.id, record);
+    m_order.insert(record.order(), record.id);
+    m_size += recordSize(record);
+    m_lastId = qMax(m_lastId, record.id);
+}
+
+bool MemoryBackend::removeRecord(uint id)
+{
+    auto it = m_records.find(id);
+    if (it == m_records.end())
+        return false;
+
+    m_size -= recordSize(it.value());
+    m_order.remove(it.value().order());
+    m_records.erase(it);
+
+    return true;
+}
+
+void MemoryBackend::clearRecords()
+{
+    m_records.clear();
+    m_order.clear();
+    m_size = 0;
+}
+
+void MemoryBackend::resetChangeLog()
+{
+    m_changes.clear();
+    logChange(NotificationChange::Cleared);
+
+    for (const NotificationRecord &record : m_records) {
+        logChange(NotificationChange::Added, record.id);
+    }
+}
+
+void MemoryBackend::logChange(NotificationChange::Operation operation, uint id)
+{
+    m_changes << NotificationChange(++m_lastSeq, operation, id);
+
+    while (m_changes.size() > ChangeLogSize) {
+        m_changes.removeFirst();
+    }
+}
+
+void MemoryBackend::enforceRetention()
+{
+    QStringList removed;
+
+    // the oldest records go first, in the order of the pages
+    while (!m_order.isEmpty()
+           && ((m_maxCount > 0 && m_records.size() > m_maxCount) || (m_maxSize > 0 && m_size > m_maxSize))) {
+        const uint id = m_order.first();
+        removeRecord(id);
+        logChange(NotificationChange::Removed, id);
+        removed << QString::number(id);
+    }
+
+    if (m_maxDays > 0) {
+        const qint64 deadline = QDateTime::currentMSecsSinceEpoch() - qint64(m_maxDays) * 24 * 60 * 60 * 1000;
+        while (!m_order.isEmpty() && m_order.firstKey().first < deadline) {
+            const uint id = m_order.first();
+            removeRecord(id);
+            logChange(NotificationChange::Removed, id);
+            removed << QString::number(id);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        commitExpired(removed);
+    }
+}
+
+void MemoryBackend::commitAdded(const NotificationRecord &record)
+{
+    emit RecordAdded(record);
+}
+
+void MemoryBackend::commitExpired(const QStringList &ids)
+{
+    emit RecordsExpired(ids);
+}
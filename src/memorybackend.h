@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORYBACKEND_H
+#define MEMORYBACKEND_H
+
+#include <QMap>
+#include <QList>
+
+#include "persistencebackend.h"
+
+class QTimer;
+
+// Keeps the records in memory only, nothing is left behind when the session ends.
+class MemoryBackend : public PersistenceBackend
+{
+    Q_OBJECT
+public:
+    explicit MemoryBackend(QObject *parent = 0);
+
+    uint open() Q_DECL_OVERRIDE;
+    // maxSize is compared with an estimate of the memory used by the records
+    void setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize) Q_DECL_OVERRIDE;
+
+    void addOne(const NotificationRecord &record) Q_DECL_OVERRIDE;
+    void removeOne(const QString &id) Q_DECL_OVERRIDE;
+    QStringList removeMany(const QStringList &ids) Q_DECL_OVERRIDE;
+    QStringList removeByApp(const QString &appName) Q_DECL_OVERRIDE;
+    void removeAll() Q_DECL_OVERRIDE;
+    void flush() Q_DECL_OVERRIDE;
+
+    // in the order of RecordOrder, like SqliteBackend
+    NotificationRecordList getAll() Q_DECL_OVERRIDE;
+    NotificationRecordList getById(const QString &id) Q_DECL_OVERRIDE;
+    NotificationRecordList getPage(int rowCount, const QString &cursorId, bool newestFirst) Q_DECL_OVERRIDE;
+
+    // the newest matches first, without any ranking
+    NotificationRecordList search(const QString &text, int limit, int offset) Q_DECL_OVERRIDE;
+
+    NotificationChangeList changesSince(qint64 seq, int limit) Q_DECL_OVERRIDE;
+
+protected:
+    // change the records without any signal, for restoring them
+    void insertRecord(const NotificationRecord &record);
+    // return false if there is no such record
+    bool removeRecord(uint id);
+    void clearRecords();
+
+    // start the change log again from the records there are now
+    void resetChangeLog();
+    void logChange(NotificationChange::Operation operation, uint id = 0);
+
+    void enforceRetention();
+
+    // called once a record is added or records expired in memory. a backend writing the
+    // changes somewhere else emits RecordAdded and RecordsExpired once they are written,
+    // here they are emitted right away.
+    virtual void commitAdded(const NotificationRecord &record);
+    virtual void commitExpired(const QStringList &ids);
+
+protected:
+    QMap<uint, NotificationRecord> m_records;
+    uint m_lastId;
+
+private:
+    // where a page after cursorId starts, the same as in SqliteBackend::getPage
+    RecordOrder cursorOrder(const QString &cursorId) const;
+
+private:
+    // the ids of m_records in the order of the history
+    QMap<RecordOrder, uint> m_order;
+    qint64 m_size;
+
+    // the log is lost with the records, so a new one has to start after the seqs of the
+    // last session: they start from the time, and there are far fewer changes than milliseconds.
+    QList<NotificationChange> m_changes;
+    qint64 m_lastSeq;
+
+    int m_maxCount;
+    int m_maxDays;
+    qint64 m_maxSize;
+    QTimer *m_retentionTimer;
+};
+
+#endif // MEMORYBACKEND_H
@@ -49,7 +49,7 @@ NotificationEntity::NotificationEntity(const NotificationEntity &notify) :
                        notify.body(), notify.actions(), notify.hints(), notify.ctime(),
                        notify.replacesId(), notify.timeout())
 {
-
+    m_image = notify.image();
 }
 
 NotificationEntity &NotificationEntity::operator=(const NotificationEntity &notify)
@@ -123,6 +123,16 @@ void NotificationEntity::setHints(const QVariantMap &hints)
     m_hints = hints;
 }
 
+QImage NotificationEntity::image() const
+{
+    return m_image;
+}
+
+void NotificationEntity::setImage(const QImage &image)
+{
+    m_image = image;
+}
+
 QString NotificationEntity::ctime() const
 {
     return m_ctime;
@@ -148,9 +158,22 @@ void NotificationEntity::setTimeout(const QString &timeout)
     m_timeout = timeout;
 }
 
+qint64 NotificationEntity::bytes() const
+{
+    qint64 chars = m_appName.size() + m_id.size() + m_appIcon.size() + m_summary.size()
+            + m_body.size() + m_ctime.size() + m_replacesId.size() + m_timeout.size();
 
+    for (const QString &action : m_actions) {
+        chars += action.size();
+    }
 
+    for (auto it = m_hints.constBegin(); it != m_hints.constEnd(); ++it) {
+        chars += it.key().size() + it.value().toString().size();
+    }
 
-
-
-
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return chars * qint64(sizeof(QChar)) + m_image.sizeInBytes();
+#else
+    return chars * qint64(sizeof(QChar)) + m_image.byteCount();
+#endif
+}
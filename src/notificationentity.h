@@ -25,6 +25,7 @@
 #include <QObject>
 #include <QStringList>
 #include <QVariantMap>
+#include <QImage>
 
 class NotificationEntity : public QObject
 {
@@ -61,6 +62,10 @@ public:
     QVariantMap hints() const;
     void setHints(const QVariantMap &hints);
 
+    // the image hint decoded at the size of the icon, the raw one is not kept in hints
+    QImage image() const;
+    void setImage(const QImage &image);
+
     QString ctime() const;
 
     QString replacesId() const;
@@ -69,6 +74,9 @@ public:
     QString timeout() const;
     void setTimeout(const QString &timeout);
 
+    // roughly the memory held by the notification, the image for the most part
+    qint64 bytes() const;
+
 private:
     QString m_appName;
     QString m_id;
@@ -77,6 +85,7 @@ private:
     QString m_body;
     QStringList m_actions;
     QVariantMap m_hints;
+    QImage m_image;
     QString m_ctime;
     QString m_replacesId;
     QString m_timeout;
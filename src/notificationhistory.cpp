@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notificationhistory.h"
+#include "persistence.h"
+#include "delayedreply.h"
+
+#include <QDBusMetaType>
+
+NotificationHistory::NotificationHistory(QObject *parent)
+    : QObject(parent)
+    , m_persistence(nullptr)
+{
+    qDBusRegisterMetaType<NotificationRecord>();
+    qDBusRegisterMetaType<NotificationRecordList>();
+}
+
+QFuture<QString> NotificationHistory::getAllRecords()
+{
+    return m_persistence->getAll();
+}
+
+QFuture<QString> NotificationHistory::getRecordsFromId(int rowCount, const QString &offsetId)
+{
+    // the result starts after offsetId in the order of insertion
+    return m_persistence->getPage(rowCount, offsetId, false);
+}
+
+QFuture<NotificationRecordList> NotificationHistory::getAllRecordsTyped()
+{
+    return m_persistence->getAllRecords();
+}
+
+QFuture<NotificationRecordList> NotificationHistory::getRecordsFromIdTyped(int rowCount, const QString &offsetId)
+{
+    return m_persistence->getRecordsPage(rowCount, offsetId, false);
+}
+
+QFuture<QString> NotificationHistory::getChangesSince(qlonglong seq, int limit)
+{
+    if (limit <= 0)
+        limit = DefaultChangesLimit;
+
+    return m_persistence->getChanges(seq, limit);
+}
+
+template <typename T, typename Reply>
+T NotificationHistory::delayedResult(const QFuture<T> &future, Reply reply)
+{
+    if (!calledFromDBus())
+        return future.result();
+
+    setDelayedReply(true);
+    replyWhenFinished(future, connection(), message(), this, reply);
+
+    return T();
+}
+
+template <typename T>
+T NotificationHistory::delayedResult(const QFuture<T> &future)
+{
+    if (!calledFromDBus())
+        return future.result();
+
+    setDelayedReply(true);
+    replyWhenFinished(future, connection(), message(), this);
+
+    return T();
+}
+
+QString NotificationHistory::GetAllRecords()
+{
+    return delayedResult(getAllRecords());
+}
+
+QString NotificationHistory::GetRecordById(const QString &id)
+{
+    return delayedResult(m_persistence->getById(id));
+}
+
+QString NotificationHistory::GetRecordsFromId(int rowCount, const QString &offsetId)
+{
+    return delayedResult(getRecordsFromId(rowCount, offsetId));
+}
+
+QString NotificationHistory::GetRecordsPage(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    return delayedResult(m_persistence->getPage(rowCount, cursorId, newestFirst));
+}
+
+NotificationRecordList NotificationHistory::GetAllRecordsTyped()
+{
+    return delayedResult(getAllRecordsTyped());
+}
+
+NotificationRecordList NotificationHistory::GetRecordByIdTyped(const QString &id)
+{
+    return delayedResult(m_persistence->getRecordsById(id));
+}
+
+NotificationRecordList NotificationHistory::GetRecordsFromIdTyped(int rowCount, const QString &offsetId)
+{
+    return delayedResult(getRecordsFromIdTyped(rowCount, offsetId));
+}
+
+NotificationRecordList NotificationHistory::GetRecordsPageTyped(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    return delayedResult(m_persistence->getRecordsPage(rowCount, cursorId, newestFirst));
+}
+
+QString NotificationHistory::SearchRecords(const QString &query, int limit, const QString &cursor, QString &nextCursor)
+{
+    if (limit <= 0)
+        limit = DefaultSearchLimit;
+
+    // the cursor is the number of hits returned by the previous pages
+    const int offset = cursor.toInt();
+    auto nextCursorOf = [=](const NotificationRecordList &records) {
+        return records.size() < limit ? QString() : QString::number(offset + records.size());
+    };
+
+    const NotificationRecordList records = delayedResult(m_persistence->search(query, limit, offset),
+                                                         [=](const NotificationRecordList &records) {
+        return QVariantList { NotificationRecord::toJson(records), nextCursorOf(records) };
+    });
+
+    nextCursor = nextCursorOf(records);
+
+    return NotificationRecord::toJson(records);
+}
+
+QString NotificationHistory::GetChangesSince(qlonglong seq, int limit)
+{
+    return delayedResult(getChangesSince(seq, limit));
+}
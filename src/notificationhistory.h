@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTIFICATIONHISTORY_H
+#define NOTIFICATIONHISTORY_H
+
+#include <QObject>
+#include <QFuture>
+#include <QDBusContext>
+
+#include "notificationrecord.h"
+
+static const int DefaultSearchLimit = 50;
+static const int DefaultChangesLimit = 1000;
+
+class Persistence;
+// The history methods of com.deepin.dde.Notification, DDENotifyDBus forwards them here.
+// Calls from D-Bus are answered with delayed replies once the persistence thread has the
+// result, QtDBus sets the context of a call on the object the adaptor belongs to.
+class NotificationHistory : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+public:
+    explicit NotificationHistory(QObject *parent = 0);
+
+    // the results of the history methods of the same names, without waiting for them
+    QFuture<QString> getAllRecords();
+    QFuture<QString> getRecordsFromId(int rowCount, const QString &offsetId);
+    QFuture<NotificationRecordList> getAllRecordsTyped();
+    QFuture<NotificationRecordList> getRecordsFromIdTyped(int rowCount, const QString &offsetId);
+    QFuture<QString> getChangesSince(qlonglong seq, int limit);
+
+public Q_SLOTS:
+    QString GetAllRecords();
+    QString GetRecordById(const QString &id);
+    QString GetRecordsFromId(int rowCount, const QString &offsetId);
+    QString GetRecordsPage(int rowCount, const QString &cursorId, bool newestFirst);
+    // the same as the methods above, but return D-Bus structures instead of JSON strings
+    NotificationRecordList GetAllRecordsTyped();
+    NotificationRecordList GetRecordByIdTyped(const QString &id);
+    NotificationRecordList GetRecordsFromIdTyped(int rowCount, const QString &offsetId);
+    NotificationRecordList GetRecordsPageTyped(int rowCount, const QString &cursorId, bool newestFirst);
+    // the cursor of the first page is empty, nextCursor is empty after the last page.
+    // bodies stored compressed are only searched in their first 1024 characters.
+    QString SearchRecords(const QString &query, int limit, const QString &cursor, QString &nextCursor);
+    // the changes of the history after seq, see PersistenceBackend::changesSince.
+    // a client mirroring the history keeps the seq of the last change it applied,
+    // and reads all records again on a "reset" change.
+    QString GetChangesSince(qlonglong seq, int limit);
+
+private:
+    // the result of future, or in a call from D-Bus a dummy one while the reply
+    // is sent once future is finished. reply as in ::replyWhenFinished.
+    template <typename T, typename Reply>
+    T delayedResult(const QFuture<T> &future, Reply reply);
+    template <typename T>
+    T delayedResult(const QFuture<T> &future);
+
+protected:
+    // created by the subclass before the object is registered on D-Bus
+    Persistence *m_persistence;
+};
+
+#endif // NOTIFICATIONHISTORY_H
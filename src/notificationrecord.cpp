@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notificationrecord.h"
+#include "notificationentity.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+NotificationRecord::NotificationRecord()
+    : id(0)
+    , ctime(0)
+    , replacesId(0)
+    , timeout(0)
+{
+
+}
+
+NotificationRecord::NotificationRecord(const NotificationEntity *entity)
+    : id(entity->id().toUInt())
+    , appName(entity->appName())
+    , appIcon(entity->appIcon())
+    , summary(entity->summary())
+    , body(entity->body())
+    , ctime(entity->ctime().toLongLong())
+    , replacesId(entity->replacesId().toUInt())
+    , timeout(entity->timeout().toInt())
+{
+
+}
+
+RecordOrder NotificationRecord::order() const
+{
+    return RecordOrder(ctime, id);
+}
+
+QJsonObject NotificationRecord::toJsonObject() const
+{
+    return QJsonObject
+    {
+        {"id", QString::number(id)},
+        {"icon", appIcon},
+        {"summary", summary},
+        {"body", body},
+        {"name", appName},
+        {"time", QString::number(ctime)}
+    };
+}
+
+QString NotificationRecord::toJson(const QList<NotificationRecord> &records, QJsonDocument::JsonFormat format)
+{
+    QJsonArray array;
+    for (const NotificationRecord &record : records) {
+        array.append(record.toJsonObject());
+    }
+
+    return QJsonDocument(array).toJson(format);
+}
+
+NotificationChange::NotificationChange()
+    : seq(0)
+    , operation(Added)
+    , id(0)
+{
+
+}
+
+NotificationChange::NotificationChange(qint64 seq, Operation operation, uint id)
+    : seq(seq)
+    , operation(operation)
+    , id(id)
+{
+
+}
+
+QJsonObject NotificationChange::toJsonObject() const
+{
+    static const char *names[] = { "", "add", "remove", "clear", "reset" };
+
+    QJsonObject object
+    {
+        {"seq", QString::number(seq)},
+        {"op", names[operation]}
+    };
+
+    if (operation == Added || operation == Removed) {
+        object.insert("id", QString::number(id));
+    }
+
+    if (operation == Added && record.id != 0) {
+        object.insert("record", record.toJsonObject());
+    }
+
+    return object;
+}
+
+QString NotificationChange::toJson(const QList<NotificationChange> &changes)
+{
+    QJsonArray array;
+    for (const NotificationChange &change : changes) {
+        array.append(change.toJsonObject());
+    }
+
+    return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+QDBusArgument &operator<<(QDBusArgument &arg, const NotificationRecord &record)
+{
+    arg.beginStructure();
+    arg << record.id << record.appName << record.appIcon << record.summary << record.body
+        << record.ctime << record.replacesId << record.timeout;
+    arg.endStructure();
+
+    return arg;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &arg, NotificationRecord &record)
+{
+    arg.beginStructure();
+    arg >> record.id >> record.appName >> record.appIcon >> record.summary >> record.body
+        >> record.ctime >> record.replacesId >> record.timeout;
+    arg.endStructure();
+
+    return arg;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     listenerri <listenerri@gmail.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTIFICATIONRECORD_H
+#define NOTIFICATIONRECORD_H
+
+#include <QString>
+#include <QPair>
+#include <QMetaType>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDBusArgument>
+
+class NotificationEntity;
+
+// the position of a record in the history: by time, then by id among records of the same time.
+// pages and the retention policy follow it in every backend and in the cache of Persistence.
+typedef QPair<qint64, uint> RecordOrder;
+
+// A plain copy of the fields of a NotificationEntity that are kept in history,
+// so it can be queued and passed around after the entity itself is deleted.
+class NotificationRecord {
+
+public:
+    NotificationRecord();
+    explicit NotificationRecord(const NotificationEntity *entity);
+
+    RecordOrder order() const;
+
+    // the object used by the JSON history APIs
+    QJsonObject toJsonObject() const;
+    // the records as a JSON array of such objects
+    static QString toJson(const QList<NotificationRecord> &records,
+                          QJsonDocument::JsonFormat format = QJsonDocument::Indented);
+
+    // D-Bus signature (ussssxui)
+    friend QDBusArgument &operator<<(QDBusArgument &arg, const NotificationRecord &record);
+    friend const QDBusArgument &operator>>(const QDBusArgument &arg, NotificationRecord &record);
+
+public:
+    uint id;
+    QString appName;
+    QString appIcon;
+    QString summary;
+    QString body;
+    qint64 ctime;
+    uint replacesId;
+    int timeout;
+};
+
+typedef QList<NotificationRecord> NotificationRecordList;
+
+// An entry of the change log of the history. The sequence numbers only grow,
+// so a client that mirrors the history asks for the changes after the last one it saw.
+class NotificationChange {
+
+public:
+    enum Operation {
+        Added = 1,
+        Removed = 2,
+        // all records before this change are gone
+        Cleared = 3,
+        // the log does not go back far enough, all records have to be read again.
+        // only made up by the queries, never stored.
+        Reset = 4
+    };
+
+    NotificationChange();
+    NotificationChange(qint64 seq, Operation operation, uint id = 0);
+
+    QJsonObject toJsonObject() const;
+    static QString toJson(const QList<NotificationChange> &changes);
+
+public:
+    qint64 seq;
+    Operation operation;
+    uint id;
+    // the added record, its id is 0 if it has been removed since
+    NotificationRecord record;
+};
+
+typedef QList<NotificationChange> NotificationChangeList;
+
+Q_DECLARE_METATYPE(NotificationRecord)
+Q_DECLARE_METATYPE(NotificationRecordList)
+
+#endif // NOTIFICATIONRECORD_H
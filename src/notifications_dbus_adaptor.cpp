@@ -35,7 +35,7 @@
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QVariant>
-#include "bubblemanager.h"
+#include "notificationhistory.h"
 
 #include <DDesktopServices>
 
@@ -74,7 +74,10 @@ QStringList NotificationsDBusAdaptor::GetCapabilities()
 QString NotificationsDBusAdaptor::GetServerInformation(QString &out1, QString &out2, QString &out3)
 {
     // handle method call org.freedesktop.Notifications.GetServerInformation
-    return static_cast<BubbleManager*>(parent())->GetServerInformation(out1, out2, out3);
+    QString out0;
+    QMetaObject::invokeMethod(parent(), "GetServerInformation", Q_RETURN_ARG(QString, out0),
+                              Q_ARG(QString &, out1), Q_ARG(QString &, out2), Q_ARG(QString &, out3));
+    return out0;
 }
 
 uint NotificationsDBusAdaptor::Notify(const QString &in0, uint in1, const QString &in2, const QString &in3, const QString &in4, const QStringList &in5, const QVariantMap &in6, int in7)
@@ -118,7 +121,10 @@ QStringList DDENotifyDBus::GetCapabilities()
 QString DDENotifyDBus::GetServerInformation(QString &out1, QString &out2, QString &out3)
 {
     // handle method call org.freedesktop.Notifications.GetServerInformation
-    return static_cast<BubbleManager*>(parent())->GetServerInformation(out1, out2, out3);
+    QString out0;
+    QMetaObject::invokeMethod(parent(), "GetServerInformation", Q_RETURN_ARG(QString, out0),
+                              Q_ARG(QString &, out1), Q_ARG(QString &, out2), Q_ARG(QString &, out3));
+    return out0;
 }
 
 uint DDENotifyDBus::Notify(const QString &in0, uint in1, const QString &in2, const QString &in3, const QString &in4, const QStringList &in5, const QVariantMap &in6, int in7)
@@ -131,25 +137,56 @@ uint DDENotifyDBus::Notify(const QString &in0, uint in1, const QString &in2, con
     return out0;
 }
 
+// the history methods reply when the persistence thread has the result, NotificationHistory
+// sends the reply itself since the D-Bus context of the call is set on the parent.
 QString DDENotifyDBus::GetAllRecords()
 {
-    QString out0;
-    QMetaObject::invokeMethod(parent(), "GetAllRecords", Q_RETURN_ARG(QString, out0));
-    return out0;
+    return static_cast<NotificationHistory*>(parent())->GetAllRecords();
 }
 
 QString DDENotifyDBus::GetRecordById(const QString &id)
 {
-    QString out0;
-    QMetaObject::invokeMethod(parent(), "GetRecordById", Q_RETURN_ARG(QString, out0), Q_ARG(QString, id));
-    return out0;
+    return static_cast<NotificationHistory*>(parent())->GetRecordById(id);
 }
 
 QString DDENotifyDBus::GetRecordsFromId(int rowCount, const QString &offsetId)
 {
-    QString out0;
-    QMetaObject::invokeMethod(parent(), "GetRecordsFromId", Q_RETURN_ARG(QString, out0), Q_ARG(int, rowCount), Q_ARG(QString, offsetId));
-    return out0;
+    return static_cast<NotificationHistory*>(parent())->GetRecordsFromId(rowCount, offsetId);
+}
+
+QString DDENotifyDBus::GetRecordsPage(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    return static_cast<NotificationHistory*>(parent())->GetRecordsPage(rowCount, cursorId, newestFirst);
+}
+
+NotificationRecordList DDENotifyDBus::GetAllRecordsTyped()
+{
+    return static_cast<NotificationHistory*>(parent())->GetAllRecordsTyped();
+}
+
+NotificationRecordList DDENotifyDBus::GetRecordByIdTyped(const QString &id)
+{
+    return static_cast<NotificationHistory*>(parent())->GetRecordByIdTyped(id);
+}
+
+NotificationRecordList DDENotifyDBus::GetRecordsFromIdTyped(int rowCount, const QString &offsetId)
+{
+    return static_cast<NotificationHistory*>(parent())->GetRecordsFromIdTyped(rowCount, offsetId);
+}
+
+NotificationRecordList DDENotifyDBus::GetRecordsPageTyped(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    return static_cast<NotificationHistory*>(parent())->GetRecordsPageTyped(rowCount, cursorId, newestFirst);
+}
+
+QString DDENotifyDBus::SearchRecords(const QString &query, int limit, const QString &cursor, QString &nextCursor)
+{
+    return static_cast<NotificationHistory*>(parent())->SearchRecords(query, limit, cursor, nextCursor);
+}
+
+QString DDENotifyDBus::GetChangesSince(qlonglong seq, int limit)
+{
+    return static_cast<NotificationHistory*>(parent())->GetChangesSince(seq, limit);
 }
 
 void DDENotifyDBus::RemoveRecord(const QString &id)
@@ -157,6 +194,16 @@ void DDENotifyDBus::RemoveRecord(const QString &id)
     QMetaObject::invokeMethod(parent(), "RemoveRecord", Q_ARG(QString, id));
 }
 
+void DDENotifyDBus::RemoveRecords(const QStringList &ids)
+{
+    QMetaObject::invokeMethod(parent(), "RemoveRecords", Q_ARG(QStringList, ids));
+}
+
+void DDENotifyDBus::RemoveRecordsByApp(const QString &appName)
+{
+    QMetaObject::invokeMethod(parent(), "RemoveRecordsByApp", Q_ARG(QString, appName));
+}
+
 void DDENotifyDBus::ClearRecords()
 {
     QMetaObject::invokeMethod(parent(), "ClearRecords");
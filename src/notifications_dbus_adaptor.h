@@ -33,6 +33,7 @@
 
 #include <QtCore/QObject>
 #include <QtDBus/QtDBus>
+#include "notificationrecord.h"
 QT_BEGIN_NAMESPACE
 class QByteArray;
 template<class T> class QList;
@@ -80,12 +81,25 @@ public Q_SLOTS:
     QString GetAllRecords();
     QString GetRecordById(const QString &id);
     QString GetRecordsFromId(int rowCount, const QString &offsetId);
+    QString GetRecordsPage(int rowCount, const QString &cursorId, bool newestFirst);
+    NotificationRecordList GetAllRecordsTyped();
+    NotificationRecordList GetRecordByIdTyped(const QString &id);
+    NotificationRecordList GetRecordsFromIdTyped(int rowCount, const QString &offsetId);
+    NotificationRecordList GetRecordsPageTyped(int rowCount, const QString &cursorId, bool newestFirst);
+    QString SearchRecords(const QString &query, int limit, const QString &cursor, QString &nextCursor);
+    QString GetChangesSince(qlonglong seq, int limit);
     void RemoveRecord(const QString &id);
+    void RemoveRecords(const QStringList &ids);
+    void RemoveRecordsByApp(const QString &appName);
     void ClearRecords();
 Q_SIGNALS: // SIGNALS
     void ActionInvoked(uint in0, const QString &in1);
     void NotificationClosed(uint in0, uint in1);
     void RecordAdded(const QString &in1);
+    void RecordAddedTyped(const NotificationRecord &in1);
+    void RecordsRemoved(const QStringList &in1);
+    void RecordsAdded(const QString &in1);
+    void RecordsAddedTyped(const NotificationRecordList &in1);
 };
 
 #endif
@@ -20,32 +20,57 @@
  */
 
 #include "persistence.h"
+#include "persistencebackend.h"
 
 #include <QStandardPaths>
-#include <QSqlError>
-#include <QSqlRecord>
 #include <QDebug>
 #include <QDir>
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
+#include <QThread>
+#include <QFutureInterface>
+
+#include <limits>
 
 #include "notificationentity.h"
 
-static const QString TableName = "notifications";
-static const QString TableName_v2 = "notifications2";
-static const QString ColumnId = "ID";
-static const QString ColumnIcon = "Icon";
-static const QString ColumnSummary = "Summary";
-static const QString ColumnBody = "Body";
-static const QString ColumnAppName = "AppName";
-static const QString ColumnCTime = "CTime";
-static const QString ColumnReplacesId = "ReplacesId";
-static const QString ColumnTimeout = "Timeout";
-
-Persistence::Persistence(QObject *parent)
+// run job in the persistence thread and return a future of its result
+template <typename T, typename Job>
+static QFuture<T> postRequest(PersistenceBackend *backend, Job job)
+{
+    QFutureInterface<T> result;
+    result.reportStarted();
+
+    backend->post([=]() mutable {
+        const T value = job();
+        result.reportFinished(&value);
+    });
+
+    return result.future();
+}
+
+// before every record in the order of the history
+static const RecordOrder NoRecordOrder(std::numeric_limits<qint64>::min(), 0);
+
+template <typename T>
+static QFuture<T> readyFuture(const T &value)
+{
+    QFutureInterface<T> result;
+    result.reportStarted();
+    result.reportFinished(&value);
+
+    return result.future();
+}
+
+Persistence::Persistence(const QString &backendName, QObject *parent)
     : QObject(parent)
+    , m_thread(new QThread(this))
+    , m_lastId(0)
+    , m_cacheFloor(0)
+    , m_cacheOrderFloor(NoRecordOrder)
+    , m_cacheHits(0)
+    , m_cacheMisses(0)
 {
+    qRegisterMetaType<NotificationRecord>();
+
     const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
 
     QDir dir(dataDir);
@@ -53,256 +78,299 @@ Persistence::Persistence(QObject *parent)
         dir.mkpath(dataDir);
     }
 
-    m_dbConnection = QSqlDatabase::addDatabase("QSQLITE", "QSQLITE");
-    m_dbConnection.setDatabaseName(dataDir + "/" + "data.db");
-    if (!m_dbConnection.open()) {
-        qWarning() << "open database error" << m_dbConnection.lastError().text();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "database open";
-#endif
-    }
+    m_backend = PersistenceBackend::create(backendName, dataDir);
+    m_backend->moveToThread(m_thread);
+
+    connect(m_thread, &QThread::finished, m_backend, &QObject::deleteLater);
+    connect(m_backend, &PersistenceBackend::RecordAdded, this, &Persistence::RecordAdded);
+    connect(m_backend, &PersistenceBackend::RecordsExpired, this, &Persistence::onRecordsExpired);
+    connect(m_backend, &PersistenceBackend::RecordsLost, this, &Persistence::onRecordsLost);
 
-    m_query = QSqlQuery(m_dbConnection);
-    m_query.setForwardOnly(true);
+    m_thread->start();
 
-    attemptCreateTable();
+    // ids are allocated in this thread, so the largest used one is needed before anything else
+    PersistenceBackend *backend = m_backend;
+    m_lastId = postRequest<uint>(backend, [=] { return backend->open(); }).result();
+
+    // the records stored before are not cached, only the ones added from now on
+    m_cacheFloor = m_lastId + 1;
+    // their times may be after the ones of new records, pages are only served by
+    // the cache above the newest of them
+    m_storedNewest = postRequest<NotificationRecordList>(backend, [=] { return backend->getPage(1, QString(), true); });
 }
 
-void Persistence::addOne(NotificationEntity *entity)
+Persistence::~Persistence()
 {
-    m_query.prepare(QString("INSERT INTO %1 (%2, %3, %4, %5, %6, %7, %8)"
-                            "VALUES (:icon, :summary, :body, :appname, :ctime, :replacesid, :timeout)") \
-                  .arg(TableName_v2, ColumnIcon, ColumnSummary, ColumnBody,
-                       ColumnAppName, ColumnCTime, ColumnReplacesId, ColumnTimeout));
-    m_query.bindValue(":icon", entity->appIcon());
-    m_query.bindValue(":summary", entity->summary());
-    m_query.bindValue(":body", entity->body());
-    m_query.bindValue(":appname", entity->appName());
-    m_query.bindValue(":ctime", entity->ctime());
-    m_query.bindValue(":replacesid", entity->replacesId());
-    m_query.bindValue(":timeout", entity->timeout());
-
-    if (!m_query.exec()) {
-        qWarning() << "insert value to database failed: " << m_query.lastError().text() << entity->id() << entity->ctime();
-        return;
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "insert value done, time is:" << entity->ctime();
-#endif
-    }
+    flush();
 
-    // to get entity's id in database
-    if (!m_query.exec(QString("SELECT last_insert_rowid() FROM %1;").arg(TableName_v2))) {
-        qWarning() << "get entity's id failed: " << m_query.lastError().text() << entity->id() << entity->ctime();
-        return;
-    } else {
-        m_query.next();
-        entity->setId(m_query.value(0).toString());
 #ifdef QT_DEBUG
-        qDebug() << "get entity's id done:" << entity->id();
+    qDebug() << "record cache hits:" << m_cacheHits << "misses:" << m_cacheMisses;
 #endif
-        emit RecordAdded(entity);
-    }
+
+    m_thread->quit();
+    m_thread->wait();
+}
+
+void Persistence::addOne(NotificationEntity *entity)
+{
+    entity->setId(QString::number(++m_lastId));
+
+    PersistenceBackend *backend = m_backend;
+    const NotificationRecord record(entity);
+    cacheRecord(record);
+    backend->post([=] { backend->addOne(record); });
 }
 
 void Persistence::addAll(QList<NotificationEntity *> entities)
 {
+    QList<NotificationRecord> records;
     for (NotificationEntity *entity : entities) {
-        addOne(entity);
+        entity->setId(QString::number(++m_lastId));
+        records << NotificationRecord(entity);
+        cacheRecord(records.last());
     }
+
+    PersistenceBackend *backend = m_backend;
+    backend->post([=] { backend->addAll(records); });
 }
 
 void Persistence::removeOne(const QString &id)
 {
-    m_query.prepare(QString("DELETE FROM %1 WHERE ID = (:id)").arg(TableName_v2));
-    m_query.bindValue(":id", id);
+    uncacheRecord(id.toUInt());
 
-    if (!m_query.exec()) {
-        qWarning() << "remove value:" << id << "from database failed: " << m_query.lastError().text();
-        return;
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "remove value:" << id;
-#endif
+    PersistenceBackend *backend = m_backend;
+    backend->post([=] { backend->removeOne(id); });
+}
+
+QFuture<QStringList> Persistence::removeMany(const QStringList &ids)
+{
+    for (const QString &id : ids) {
+        uncacheRecord(id.toUInt());
+    }
+
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QStringList>(backend, [=] { return backend->removeMany(ids); });
+}
+
+QFuture<QStringList> Persistence::removeByApp(const QString &appName)
+{
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (it.value().appName == appName) {
+            m_cacheOrder.remove(it.value().order());
+            it = m_cache.erase(it);
+        } else {
+            ++it;
+        }
     }
+
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QStringList>(backend, [=] { return backend->removeByApp(appName); });
 }
 
 void Persistence::removeAll()
 {
-    m_query.prepare(QString("DELETE FROM %1").arg(TableName_v2));
+    // nothing is left, so the cache holds every record from now on
+    m_cache.clear();
+    m_cacheOrder.clear();
+    m_cacheFloor = 0;
+    m_cacheOrderFloor = NoRecordOrder;
+    m_storedNewest = readyFuture(NotificationRecordList());
+
+    PersistenceBackend *backend = m_backend;
+    backend->post([=] { backend->removeAll(); });
+}
 
-    if (!m_query.exec()) {
-        qWarning() << "remove all from database failed: " << m_query.lastError().text();
-        return;
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "remove all done";
-#endif
-    }
+void Persistence::flush()
+{
+    PersistenceBackend *backend = m_backend;
+    postRequest<bool>(backend, [=] { backend->flush(); return true; }).waitForFinished();
+}
 
-    // Remove the unused space
-    if (!m_query.exec("VACUUM")) {
-        qWarning() << "remove the unused space failed: " << m_query.lastError().text();
-        return;
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "remove the unused space done";
-#endif
-    }
+void Persistence::setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize)
+{
+    PersistenceBackend *backend = m_backend;
+    backend->post([=] { backend->setRetentionPolicy(maxCount, maxDays, maxSize); });
 }
 
-QString Persistence::getAll()
+QFuture<QString> Persistence::getAll()
 {
-    m_query.prepare(QString("SELECT %1, %2, %3, %4, %5, %6 FROM %7")
-               .arg(ColumnId, ColumnIcon, ColumnSummary, ColumnBody, ColumnAppName,
-                    ColumnCTime, TableName_v2));
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QString>(backend, [=] { return NotificationRecord::toJson(backend->getAll()); });
+}
 
-    if (!m_query.exec()) {
-        qWarning() << "get all from database failed: " << m_query.lastError().text();
-        return QString();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "get all done";
-#endif
-    }
+QFuture<QString> Persistence::getById(const QString &id)
+{
+    NotificationRecordList records;
+    if (cachedById(id, records))
+        return readyFuture(NotificationRecord::toJson(records));
 
-    QJsonArray array1;
-    while (m_query.next())
-    {
-        QJsonObject obj
-        {
-            {"id", m_query.value(0).toString()},
-            {"icon", m_query.value(1).toString()},
-            {"summary", m_query.value(2).toString()},
-            {"body", m_query.value(3).toString()},
-            {"name", m_query.value(4).toString()},
-            {"time", m_query.value(5).toString()}
-        };
-        array1.append(obj);
-    }
-    return QJsonDocument(array1).toJson();
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QString>(backend, [=] { return NotificationRecord::toJson(backend->getById(id)); });
 }
 
-QString Persistence::getById(const QString &id)
+QFuture<QString> Persistence::getPage(int rowCount, const QString &cursorId, bool newestFirst)
 {
-    m_query.prepare(QString("SELECT %1, %2, %3, %4, %5, %6 FROM %7 WHERE ID = (:id)")
-               .arg(ColumnId, ColumnIcon, ColumnSummary, ColumnBody, ColumnAppName,
-                    ColumnCTime, TableName_v2));
-    m_query.bindValue(":id", id);
-
-    if (!m_query.exec()) {
-        qWarning() << "get data by id:" << id << "failed: " << m_query.lastError().text();
-        return QString();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "get data by id:" << id << "done";
-#endif
-    }
+    NotificationRecordList records;
+    if (cachedPage(rowCount, cursorId, newestFirst, records))
+        return readyFuture(NotificationRecord::toJson(records));
 
-    QJsonArray array;
-    while (m_query.next())
-    {
-        QJsonObject obj
-        {
-            {"id", m_query.value(0).toString()},
-            {"icon", m_query.value(1).toString()},
-            {"summary", m_query.value(2).toString()},
-            {"body", m_query.value(3).toString()},
-            {"name", m_query.value(4).toString()},
-            {"time", m_query.value(5).toString()}
-        };
-        array.append(obj);
-    }
-    qDebug() << array;
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QString>(backend, [=] { return NotificationRecord::toJson(backend->getPage(rowCount, cursorId, newestFirst)); });
+}
 
-    if (array.size() > 1) {
-        qWarning() << "more than one data has been obtained by id:" << id;
-    }
+QFuture<NotificationRecordList> Persistence::getAllRecords()
+{
+    PersistenceBackend *backend = m_backend;
+    return postRequest<NotificationRecordList>(backend, [=] { return backend->getAll(); });
+}
+
+QFuture<NotificationRecordList> Persistence::getRecordsById(const QString &id)
+{
+    NotificationRecordList records;
+    if (cachedById(id, records))
+        return readyFuture(records);
 
-    return QJsonDocument(array).toJson();
+    PersistenceBackend *backend = m_backend;
+    return postRequest<NotificationRecordList>(backend, [=] { return backend->getById(id); });
 }
 
-QString Persistence::getFrom(int rowCount, const QString &offsetId)
+QFuture<NotificationRecordList> Persistence::getRecordsPage(int rowCount, const QString &cursorId, bool newestFirst)
 {
-    // gets the line number of the specified offset
-    m_query.prepare(QString("SELECT count() FROM %1 WHERE ID <= (:offsetId)").arg(TableName_v2));
-    m_query.bindValue(":offsetId", offsetId);
+    NotificationRecordList records;
+    if (cachedPage(rowCount, cursorId, newestFirst, records))
+        return readyFuture(records);
 
-    if (!m_query.exec()) {
-        qWarning() << "get line number failed: " << m_query.lastError().text();
-        return QString();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "get line number done";
-#endif
+    PersistenceBackend *backend = m_backend;
+    return postRequest<NotificationRecordList>(backend, [=] { return backend->getPage(rowCount, cursorId, newestFirst); });
+}
+
+QFuture<NotificationRecordList> Persistence::search(const QString &text, int limit, int offset)
+{
+    PersistenceBackend *backend = m_backend;
+    return postRequest<NotificationRecordList>(backend, [=] { return backend->search(text, limit, offset); });
+}
+
+QFuture<QString> Persistence::getChanges(qint64 seq, int limit)
+{
+    PersistenceBackend *backend = m_backend;
+    return postRequest<QString>(backend, [=] { return NotificationChange::toJson(backend->changesSince(seq, limit)); });
+}
+
+void Persistence::onRecordsExpired(const QStringList &ids)
+{
+    for (const QString &id : ids) {
+        uncacheRecord(id.toUInt());
     }
 
-    m_query.next();
-    QString rowNum = m_query.value(0).toString();
-    if (rowNum.isEmpty()) {
-        qWarning() << "the line number is invalid: ";
-        return QString();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "line number is valid";
-#endif
+    Q_EMIT RecordsExpired(ids);
+}
+
+void Persistence::onRecordsLost(const QStringList &ids)
+{
+    // they were cached when they were added, but are not in the backend
+    for (const QString &id : ids) {
+        uncacheRecord(id.toUInt());
     }
 
-    // get data from rowNum+1
-    m_query.prepare(QString("SELECT %1, %2, %3, %4, %5, %6 FROM %7 LIMIT (:rowCount) OFFSET (:offset)")
-               .arg(ColumnId, ColumnIcon, ColumnSummary, ColumnBody, ColumnAppName,
-                    ColumnCTime, TableName_v2));
-    m_query.bindValue(":rowCount", rowCount);
-    m_query.bindValue(":offset", rowNum);
+    Q_EMIT RecordsLost(ids);
+}
 
-    if (!m_query.exec()) {
-        qWarning() << "get data from database failed: " << m_query.lastError().text();
-        return QString();
-    } else {
-#ifdef QT_DEBUG
-        qDebug() << "get data done";
-#endif
+void Persistence::cacheRecord(const NotificationRecord &record)
+{
+    m_cache.insert(record.id, record);
+    m_cacheOrder.insert(record.order(), record.id);
+
+    // the oldest record leaves the cache, so it is not complete up to it any more
+    while (m_cache.size() > RecordCacheSize) {
+        const uint id = m_cacheOrder.first();
+        m_cacheOrderFloor = qMax(m_cacheOrderFloor, m_cacheOrder.firstKey());
+        m_cacheFloor = qMax(m_cacheFloor, id + 1);
+        m_cacheOrder.erase(m_cacheOrder.begin());
+        m_cache.remove(id);
     }
+}
 
-    QJsonArray array;
-    while (m_query.next())
-    {
-        QJsonObject obj
-        {
-            {"id", m_query.value(0).toString()},
-            {"icon", m_query.value(1).toString()},
-            {"summary", m_query.value(2).toString()},
-            {"body", m_query.value(3).toString()},
-            {"name", m_query.value(4).toString()},
-            {"time", m_query.value(5).toString()}
-        };
-        array.append(obj);
+void Persistence::uncacheRecord(uint id)
+{
+    auto it = m_cache.find(id);
+    if (it == m_cache.end())
+        return;
+
+    m_cacheOrder.remove(it.value().order());
+    m_cache.erase(it);
+}
+
+bool Persistence::cachedById(const QString &id, NotificationRecordList &records)
+{
+    bool ok = false;
+    const uint key = id.toUInt(&ok);
+
+    if (!ok || key < m_cacheFloor) {
+        ++m_cacheMisses;
+        return false;
+    }
+
+    if (m_cache.contains(key)) {
+        records << m_cache.value(key);
     }
-    qDebug() << array;
 
-    return QJsonDocument(array).toJson();
+    ++m_cacheHits;
+    return true;
 }
 
-void Persistence::attemptCreateTable()
+bool Persistence::cachedPage(int rowCount, const QString &cursorId, bool newestFirst, NotificationRecordList &records)
 {
+    if (rowCount < 0 || !m_storedNewest.isFinished()) {
+        ++m_cacheMisses;
+        return false;
+    }
+
+    // every record after floor in the order of the history is cached
+    RecordOrder floor = m_cacheOrderFloor;
+    if (!m_storedNewest.result().isEmpty()) {
+        floor = qMax(floor, m_storedNewest.result().first().order());
+    }
 
-    m_query.prepare(QString("CREATE TABLE IF NOT EXISTS %1"
-                          "("
-                          "%2 INTEGER PRIMARY KEY   AUTOINCREMENT,"
-                          "%3 TEXT,"
-                          "%4 TEXT,"
-                          "%5 TEXT,"
-                          "%6 TEXT,"
-                          "%7 TEXT,"
-                          "%8 TEXT,"
-                          "%9 TEXT"
-                          ");").arg(TableName_v2,
-                                ColumnId, ColumnIcon, ColumnSummary,
-                                ColumnBody, ColumnAppName, ColumnCTime,
-                                ColumnReplacesId, ColumnTimeout));
-
-    if (!m_query.exec()) {
-        qWarning() << "create table failed" << m_query.lastError().text();
+    // the page starts after the cursor as in the backends, an uncached cursor is left to them
+    RecordOrder cursor = NoRecordOrder;
+    if (!cursorId.isEmpty()) {
+        bool ok = false;
+        auto it = m_cache.constFind(cursorId.toUInt(&ok));
+        if (!ok || it == m_cache.constEnd()) {
+            ++m_cacheMisses;
+            return false;
+        }
+        cursor = it.value().order();
     }
+
+    const QMap<RecordOrder, uint> &order = m_cacheOrder;
+
+    if (newestFirst) {
+        auto it = cursorId.isEmpty() ? order.end() : order.lowerBound(cursor);
+        while (records.size() < rowCount && it != order.begin()) {
+            --it;
+            if (!(floor < it.key()))
+                break;
+            records << m_cache.value(it.value());
+        }
+
+        // the page may go on with records that are not cached
+        if (records.size() < rowCount && floor != NoRecordOrder) {
+            records.clear();
+            ++m_cacheMisses;
+            return false;
+        }
+    } else {
+        if (cursor < floor) {
+            ++m_cacheMisses;
+            return false;
+        }
+
+        for (auto it = order.upperBound(cursor); it != order.end() && records.size() < rowCount; ++it) {
+            records << m_cache.value(it.value());
+        }
+    }
+
+    ++m_cacheHits;
+    return true;
 }
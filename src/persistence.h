@@ -23,37 +23,98 @@
 #define PERSISTENCE_H
 
 #include <QObject>
-#include <QSqlDatabase>
-#include <QSqlQuery>
+#include <QFuture>
+#include <QMap>
+#include <QStringList>
 
+#include "notificationrecord.h"
+
+// the number of the newest records kept in memory for getById() and getPage()
+static const int RecordCacheSize = 256;
+
+class QThread;
 class NotificationEntity;
+class PersistenceBackend;
 class Persistence : public QObject
 {
     Q_OBJECT
 public:
-    explicit Persistence(QObject *parent = 0);
+    // see PersistenceBackend::create for the backend names
+    explicit Persistence(const QString &backendName, QObject *parent = 0);
+    ~Persistence();
 
+    // the entity gets its id immediately, the record is written
+    // to the database later in the persistence thread.
     void addOne(NotificationEntity *entity);
     void addAll(QList<NotificationEntity*> entities);
     void removeOne(const QString &id);
+    // the results are the ids of the records that existed
+    QFuture<QStringList> removeMany(const QStringList &ids);
+    QFuture<QStringList> removeByApp(const QString &appName);
     void removeAll();
 
-    QString getAll();
-    QString getById(const QString &id);
+    // block until all pending records are stored by the backend
+    void flush();
+
+    // see PersistenceBackend::setRetentionPolicy
+    void setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize);
+
+    // the records encoded as a JSON array, the encoding is done in the persistence thread too
+    QFuture<QString> getAll();
+    QFuture<QString> getById(const QString &id);
+
+    // see PersistenceBackend::getPage
+    QFuture<QString> getPage(int rowCount, const QString &cursorId, bool newestFirst);
+
+    QFuture<NotificationRecordList> getAllRecords();
+    QFuture<NotificationRecordList> getRecordsById(const QString &id);
+    QFuture<NotificationRecordList> getRecordsPage(int rowCount, const QString &cursorId, bool newestFirst);
 
-    // the result starts with offset + 1
-    // If rowcount is - 1, it is obtained from offset + 1 to the last.
-    QString getFrom(int rowCount, const QString &offsetId);
+    // see PersistenceBackend::search
+    QFuture<NotificationRecordList> search(const QString &text, int limit, int offset);
+
+    // see PersistenceBackend::changesSince, encoded by NotificationChange::toJson
+    QFuture<QString> getChanges(qint64 seq, int limit);
+
+    // requests of getById() and getPage() served by the record cache or not
+    int cacheHits() const { return m_cacheHits; }
+    int cacheMisses() const { return m_cacheMisses; }
 
 signals:
-    void RecordAdded(NotificationEntity *entify);
+    void RecordAdded(const NotificationRecord &record);
+    // the records removed by the retention policy
+    void RecordsExpired(const QStringList &ids);
+    // the records the backend failed to store
+    void RecordsLost(const QStringList &ids);
+
+private Q_SLOTS:
+    void onRecordsExpired(const QStringList &ids);
+    void onRecordsLost(const QStringList &ids);
 
 private:
-    void attemptCreateTable();
+    void cacheRecord(const NotificationRecord &record);
+    void uncacheRecord(uint id);
+    bool cachedById(const QString &id, NotificationRecordList &records);
+    bool cachedPage(int rowCount, const QString &cursorId, bool newestFirst, NotificationRecordList &records);
 
 private:
-    QSqlDatabase m_dbConnection;
-    QSqlQuery m_query;
+    QThread *m_thread;
+    PersistenceBackend *m_backend;
+
+    uint m_lastId;
+
+    // all records with an id not less than m_cacheFloor are in m_cache,
+    // so a missing id there means the record does not exist.
+    QMap<uint, NotificationRecord> m_cache;
+    uint m_cacheFloor;
+    // the ids of m_cache in the order of the history, pages are served from it.
+    // all records after m_cacheOrderFloor and after the newest record stored
+    // before the start are in m_cache.
+    QMap<RecordOrder, uint> m_cacheOrder;
+    RecordOrder m_cacheOrderFloor;
+    QFuture<NotificationRecordList> m_storedNewest;
+    int m_cacheHits;
+    int m_cacheMisses;
 };
 
 #endif // PERSISTENCE_H
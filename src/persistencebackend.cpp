@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "persistencebackend.h"
+#include "sqlitebackend.h"
+#include "memorybackend.h"
+#include "logbackend.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QRegularExpression>
+#include <QDebug>
+
+// posted to the backend to run a job in its thread
+class PersistenceJobEvent : public QEvent
+{
+public:
+    explicit PersistenceJobEvent(const std::function<void()> &job)
+        : QEvent(Type)
+        , job(job)
+    {
+    }
+
+    static const QEvent::Type Type = static_cast<QEvent::Type>(QEvent::User + 1);
+    std::function<void()> job;
+};
+
+PersistenceBackend::PersistenceBackend(QObject *parent)
+    : QObject(parent)
+{
+}
+
+PersistenceBackend *PersistenceBackend::create(const QString &name, const QString &dataDir)
+{
+    if (name == "memory")
+        return new MemoryBackend;
+
+    if (name == "log")
+        return new LogBackend(dataDir + "/" + "data.log");
+
+    if (name != "sqlite") {
+        qWarning() << "unknown persistence backend:" << name << ", using sqlite";
+    }
+
+    return new SqliteBackend(dataDir + "/" + "data.db");
+}
+
+void PersistenceBackend::post(const std::function<void()> &job)
+{
+    QCoreApplication::postEvent(this, new PersistenceJobEvent(job));
+}
+
+void PersistenceBackend::addAll(const QList<NotificationRecord> &records)
+{
+    for (const NotificationRecord &record : records) {
+        addOne(record);
+    }
+}
+
+QStringList PersistenceBackend::searchWords(const QString &text)
+{
+    // the words are matched rather than split, so no SkipEmptyParts, which moved to Qt:: in 5.14
+    static const QRegularExpression wordExpression("\\S+");
+
+    QStringList words;
+    QRegularExpressionMatchIterator it = wordExpression.globalMatch(text);
+    while (it.hasNext()) {
+        words << it.next().captured();
+    }
+
+    return words;
+}
+
+bool PersistenceBackend::logCovers(qint64 seq, const NotificationChange &first, qint64 lastSeq)
+{
+    // a seq the log never reached comes from another log
+    if (seq > lastSeq)
+        return false;
+
+    if (first.seq == 0)
+        return seq == lastSeq;
+
+    // the changes before a Cleared one do not matter
+    return seq + 1 >= first.seq || first.operation == NotificationChange::Cleared;
+}
+
+void PersistenceBackend::customEvent(QEvent *event)
+{
+    if (event->type() == PersistenceJobEvent::Type) {
+        static_cast<PersistenceJobEvent *>(event)->job();
+        return;
+    }
+
+    QObject::customEvent(event);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERSISTENCEBACKEND_H
+#define PERSISTENCEBACKEND_H
+
+#include <QObject>
+#include <QStringList>
+
+#include <functional>
+
+#include "notificationrecord.h"
+
+// the number of the newest changes kept in the change log
+static const int ChangeLogSize = 20000;
+
+// backends write their pending changes when there are FlushThreshold of them,
+// or when the first of them has been waiting for FlushDelay milliseconds.
+static const int FlushThreshold = 64;
+static const int FlushDelay = 200;
+// a write that failed is tried again by the next FlushRetries - 1 flushes,
+// the records are lost after that.
+static const int FlushRetries = 3;
+
+// the age limit of the retention policy is checked every RetentionCheckInterval
+// milliseconds, also when nothing is written.
+static const int RetentionCheckInterval = 60 * 60 * 1000;
+
+// Where Persistence stores the records. A backend lives in its own thread,
+// and all of its methods must be called from that thread, normally through post().
+class PersistenceBackend : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PersistenceBackend(QObject *parent = 0);
+
+    // the backend called name keeping its data in dataDir, "sqlite" for an unknown name.
+    // the known names are "sqlite", "memory" and "log".
+    static PersistenceBackend *create(const QString &name, const QString &dataDir);
+
+    // run the job in the thread of the backend, jobs are run in the order they are posted.
+    // this is the only method that can be called from other threads.
+    void post(const std::function<void()> &job);
+
+    // open the storage and return the largest id ever used in it
+    virtual uint open() = 0;
+
+    // keep at most maxCount records, no record older than maxDays days and
+    // no more than maxSize bytes of records. 0 means no limit.
+    virtual void setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize) = 0;
+
+    // the record may only be stored by the next flush
+    virtual void addOne(const NotificationRecord &record) = 0;
+    virtual void addAll(const QList<NotificationRecord> &records);
+    virtual void removeOne(const QString &id) = 0;
+    // remove the records at once and return the ids of those that existed
+    virtual QStringList removeMany(const QStringList &ids) = 0;
+    virtual QStringList removeByApp(const QString &appName) = 0;
+    virtual void removeAll() = 0;
+
+    // store all pending records
+    virtual void flush() = 0;
+
+    virtual NotificationRecordList getAll() = 0;
+    virtual NotificationRecordList getById(const QString &id) = 0;
+
+    // return at most rowCount records older than cursorId from the newest one,
+    // or newer than cursorId from the oldest one, depending on newestFirst.
+    // records are ordered by their time, then by id, the records migrated from the first
+    // table version got ids after newer ones. the retention policy removes them in the same order.
+    // an empty cursorId starts from the first record, a rowCount of -1 means no limit.
+    virtual NotificationRecordList getPage(int rowCount, const QString &cursorId, bool newestFirst) = 0;
+
+    // return the records whose summary, body or app name contain all the words in text,
+    // the best matches first.
+    virtual NotificationRecordList search(const QString &text, int limit, int offset) = 0;
+
+    // return at most limit changes after seq from the oldest one, or a single Reset change
+    // if some of them are not in the log any more. the log starts with a Cleared change
+    // followed by the records that existed when it was created, so 0 gets them all.
+    virtual NotificationChangeList changesSince(qint64 seq, int limit) = 0;
+
+signals:
+    // emitted once the record is stored
+    void RecordAdded(const NotificationRecord &record);
+    // emitted after the retention policy removed records, with their ids
+    void RecordsExpired(const QStringList &ids);
+    // emitted with the ids of the records that could not be stored
+    void RecordsLost(const QStringList &ids);
+
+protected:
+    // whether all changes after seq are in a log that starts with first, an empty one
+    // if its seq is 0, and whose last change is lastSeq
+    static bool logCovers(qint64 seq, const NotificationChange &first, qint64 lastSeq);
+
+    // the words a search text is split into at whitespace
+    static QStringList searchWords(const QString &text);
+
+    void customEvent(QEvent *event) Q_DECL_OVERRIDE;
+};
+
+#endif // PERSISTENCEBACKEND_H
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RUNNABLEJOB_H
+#define RUNNABLEJOB_H
+
+#include <QRunnable>
+
+#include <functional>
+
+// Runs a function in a QThreadPool, which deletes the job once it has run.
+class RunnableJob : public QRunnable
+{
+public:
+    explicit RunnableJob(const std::function<void()> &job)
+        : m_job(job)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE { m_job(); }
+
+private:
+    std::function<void()> m_job;
+};
+
+#endif // RUNNABLEJOB_H
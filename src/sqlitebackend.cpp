@@ -0,0 +1,1294 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sqlitebackend.h"
+
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QDebug>
+#include <QTimer>
+#include <QDateTime>
+#include <QStringList>
+
+#include <limits>
+
+static const QString TableName = "notifications";
+static const QString TableName_v2 = "notifications2";
+static const QString TableName_v3 = "notifications3";
+static const QString TableName_v4 = "notifications4";
+// notifications4 joined with the dictionaries, with the columns of notifications3
+static const QString TableName_view = "notifications4_view";
+static const QString TableName_apps = "apps";
+static const QString TableName_icons = "icons";
+static const QString TableName_search = "notifications4_fts";
+static const QString TableName_search_v2 = "notifications2_fts";
+static const QString TableName_search_v3 = "notifications3_fts";
+static const QString TableName_changes = "changes";
+static const QString ColumnId = "ID";
+static const QString ColumnIcon = "Icon";
+static const QString ColumnSummary = "Summary";
+static const QString ColumnBody = "Body";
+static const QString ColumnAppName = "AppName";
+static const QString ColumnCTime = "CTime";
+static const QString ColumnReplacesId = "ReplacesId";
+static const QString ColumnTimeout = "Timeout";
+static const QString ColumnBodyData = "BodyData";
+static const QString ColumnAppId = "AppId";
+static const QString ColumnIconId = "IconId";
+static const QString ColumnValue = "Value";
+static const QString ColumnSeq = "Seq";
+static const QString ColumnOperation = "Op";
+static const QString ColumnRecordId = "RecordId";
+
+// stored in PRAGMA user_version, the tables of older versions are migrated
+// to notifications4 MigrationBatch records at a time after the database is opened.
+static const int SchemaVersion = 4;
+static const int MigrationBatch = 500;
+
+// bodies longer than this are stored compressed in BodyData, Body keeps
+// the first BodyPrefixLength characters of them for searching. the rest is
+// not indexed: the fts5 delete triggers have to repeat the indexed text and
+// can not decompress BodyData.
+static const int BodyCompressThreshold = 4096;
+static const int BodyPrefixLength = 1024;
+
+// records beyond the retention policy are removed RetentionBatch at a time, RetentionDelay
+// milliseconds after a write and then every RetentionBatchInterval until none are left.
+static const int RetentionBatch = 200;
+static const int RetentionDelay = 1000;
+static const int RetentionBatchInterval = 100;
+
+// free pages given back to the file system by each incremental vacuum step
+static const int VacuumPages = 256;
+
+// the comma separated columns prefixed with table, for queries joining it with others
+static QString qualifiedColumns(const QString &columns, const QString &table)
+{
+    QStringList qualified;
+    for (const QString &column : columns.split(", ")) {
+        qualified << table + "." + column;
+    }
+
+    return qualified.join(", ");
+}
+
+SqliteBackend::SqliteBackend(const QString &databasePath, QObject *parent)
+    : PersistenceBackend(parent)
+    , m_databasePath(databasePath)
+    , m_flushTimer(new QTimer(this))
+    , m_flushFailures(0)
+    , m_maxCount(0)
+    , m_maxDays(0)
+    , m_maxSize(0)
+    , m_incrementalVacuum(false)
+    , m_retentionTimer(new QTimer(this))
+    , m_fullTextSearch(false)
+    , m_nextLegacyId(0)
+    , m_compressThreshold(BodyCompressThreshold)
+    , m_pruneDictionaries(false)
+{
+    m_flushTimer->setInterval(FlushDelay);
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &SqliteBackend::flush);
+
+    m_retentionTimer->setSingleShot(true);
+    connect(m_retentionTimer, &QTimer::timeout, this, &SqliteBackend::enforceRetention);
+}
+
+SqliteBackend::~SqliteBackend()
+{
+    flush();
+
+    const QString connectionName = m_dbConnection.connectionName();
+    m_query = QSqlQuery();
+    m_insertQuery = QSqlQuery();
+    m_removeQuery = QSqlQuery();
+    m_getAllQuery = QSqlQuery();
+    m_getByIdQuery = QSqlQuery();
+    m_pageNewestFirstQuery = QSqlQuery();
+    m_pageOldestFirstQuery = QSqlQuery();
+    m_cursorTimeQuery = QSqlQuery();
+    m_countBoundaryQuery = QSqlQuery();
+    m_removeUpToQuery = QSqlQuery();
+    m_removeOlderQuery = QSqlQuery();
+    m_removeOldestQuery = QSqlQuery();
+    m_searchQuery = QSqlQuery();
+    m_idsByAppQuery = QSqlQuery();
+    m_removeByAppQuery = QSqlQuery();
+    m_internAppQuery = QSqlQuery();
+    m_internIconQuery = QSqlQuery();
+    m_changesQuery = QSqlQuery();
+    m_firstChangeQuery = QSqlQuery();
+    m_trimChangesQuery = QSqlQuery();
+    m_removedSinceQuery = QSqlQuery();
+    m_dbConnection.close();
+    m_dbConnection = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+uint SqliteBackend::open()
+{
+    // the connection can only be used in the thread that created it,
+    // so it is created here instead of in the constructor.
+    m_dbConnection = QSqlDatabase::addDatabase("QSQLITE", "QSQLITE");
+    m_dbConnection.setDatabaseName(m_databasePath);
+    if (!m_dbConnection.open()) {
+        qWarning() << "open database error" << m_dbConnection.lastError().text();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "database open";
+#endif
+    }
+
+    m_query = QSqlQuery(m_dbConnection);
+    m_query.setForwardOnly(true);
+
+    // only takes effect on a new database, existing ones are converted by enableIncrementalVacuum()
+    if (!m_query.exec("PRAGMA auto_vacuum = INCREMENTAL")) {
+        qWarning() << "set auto vacuum failed: " << m_query.lastError().text();
+    }
+
+    attemptCreateTable();
+    attemptCreateChangeLog();
+    loadDictionaries();
+
+    // the records of the first table version get their ids when they are migrated,
+    // so they are reserved after the largest one used so far. they are older than the
+    // others all the same, records are ordered by CTime before ID.
+    uint lastId = queryLastId();
+    lastId += attemptMigrate(lastId + 1);
+
+    attemptCreateSearchIndex();
+    prepareQueries();
+
+    post([this] { enableIncrementalVacuum(); });
+
+    return lastId;
+}
+
+void SqliteBackend::setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize)
+{
+    m_maxCount = maxCount;
+    m_maxDays = maxDays;
+    m_maxSize = maxSize;
+
+    scheduleRetention(RetentionDelay);
+}
+
+void SqliteBackend::setBodyCompression(int threshold)
+{
+    m_compressThreshold = threshold;
+}
+
+void SqliteBackend::addOne(const NotificationRecord &record)
+{
+    m_pendingRecords << record;
+
+    if (m_pendingRecords.size() >= FlushThreshold) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void SqliteBackend::flush()
+{
+    m_flushTimer->stop();
+
+    if (m_pendingRecords.isEmpty())
+        return;
+
+    const QList<NotificationRecord> records = m_pendingRecords;
+    m_pendingRecords.clear();
+
+    // the names added to the dictionaries are gone too if the transaction is rolled back
+    const QHash<QString, qint64> appIds = m_appIds;
+    const QHash<QString, qint64> iconIds = m_iconIds;
+
+    if (!m_dbConnection.transaction()) {
+        qWarning() << "begin transaction failed: " << m_dbConnection.lastError().text();
+        retryFlush(records);
+        return;
+    }
+
+    // the last attempt keeps the records that could be inserted, the others are lost
+    const bool lastAttempt = m_flushFailures + 1 >= FlushRetries;
+
+    QList<NotificationRecord> inserted;
+    QStringList failed;
+    for (const NotificationRecord &record : records) {
+        if (insertRecord(record)) {
+            inserted << record;
+        } else {
+            failed << QString::number(record.id);
+        }
+    }
+
+    // a batch with records that could not be inserted is tried again as a whole
+    if (!failed.isEmpty() && !lastAttempt) {
+        m_dbConnection.rollback();
+        m_appIds = appIds;
+        m_iconIds = iconIds;
+        retryFlush(records);
+        return;
+    }
+
+    if (!m_dbConnection.commit()) {
+        qWarning() << "commit transaction failed: " << m_dbConnection.lastError().text();
+        m_dbConnection.rollback();
+        m_appIds = appIds;
+        m_iconIds = iconIds;
+        retryFlush(records);
+        return;
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "insert values done, count:" << inserted.size();
+#endif
+    }
+
+    m_flushFailures = 0;
+
+    for (const NotificationRecord &record : inserted) {
+        emit RecordAdded(record);
+    }
+
+    if (!failed.isEmpty()) {
+        emit RecordsLost(failed);
+    }
+
+    scheduleRetention(RetentionDelay);
+}
+
+void SqliteBackend::retryFlush(const QList<NotificationRecord> &records)
+{
+    if (++m_flushFailures < FlushRetries) {
+        // before the records added since, which are newer
+        m_pendingRecords = records + m_pendingRecords;
+        m_flushTimer->start();
+        return;
+    }
+
+    qWarning() << "give up storing" << records.size() << "records after" << m_flushFailures << "attempts";
+    m_flushFailures = 0;
+
+    QStringList ids;
+    for (const NotificationRecord &record : records) {
+        ids << QString::number(record.id);
+    }
+
+    emit RecordsLost(ids);
+}
+
+bool SqliteBackend::insertRecord(const NotificationRecord &record)
+{
+    m_insertQuery.bindValue(":id", record.id);
+    m_insertQuery.bindValue(":iconid", intern(m_internIconQuery, m_iconIds, record.appIcon));
+    m_insertQuery.bindValue(":summary", record.summary);
+    if (m_compressThreshold > 0 && record.body.size() > m_compressThreshold) {
+        const QByteArray data = qCompress(record.body.toUtf8());
+        m_insertQuery.bindValue(":body", record.body.left(BodyPrefixLength));
+        m_insertQuery.bindValue(":bodydata", data);
+    } else {
+        m_insertQuery.bindValue(":body", record.body);
+        m_insertQuery.bindValue(":bodydata", QVariant(QVariant::ByteArray));
+    }
+    m_insertQuery.bindValue(":appid", intern(m_internAppQuery, m_appIds, record.appName));
+    m_insertQuery.bindValue(":ctime", record.ctime);
+    m_insertQuery.bindValue(":replacesid", record.replacesId);
+    m_insertQuery.bindValue(":timeout", record.timeout);
+
+    if (!m_insertQuery.exec()) {
+        qWarning() << "insert value to database failed: " << m_insertQuery.lastError().text() << record.id << record.ctime;
+        return false;
+    }
+
+    return true;
+}
+
+void SqliteBackend::removeOne(const QString &id)
+{
+    flush();
+    completeMigration();
+
+    m_removeQuery.bindValue(":id", id);
+
+    if (!m_removeQuery.exec()) {
+        qWarning() << "remove value:" << id << "from database failed: " << m_removeQuery.lastError().text();
+        return;
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "remove value:" << id;
+#endif
+    }
+
+    m_pruneDictionaries = true;
+    scheduleRetention(RetentionDelay);
+}
+
+QStringList SqliteBackend::removeMany(const QStringList &ids)
+{
+    flush();
+    completeMigration();
+
+    if (!m_dbConnection.transaction()) {
+        qWarning() << "begin transaction failed: " << m_dbConnection.lastError().text();
+    }
+
+    QStringList removed;
+    for (const QString &id : ids) {
+        m_removeQuery.bindValue(":id", id);
+
+        if (!m_removeQuery.exec()) {
+            qWarning() << "remove value:" << id << "from database failed: " << m_removeQuery.lastError().text();
+        } else if (m_removeQuery.numRowsAffected() > 0) {
+            removed << id;
+        }
+    }
+
+    if (!m_dbConnection.commit()) {
+        qWarning() << "commit transaction failed: " << m_dbConnection.lastError().text();
+        m_dbConnection.rollback();
+        return QStringList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "remove values done, count:" << removed.size();
+#endif
+    }
+
+    m_pruneDictionaries = true;
+    scheduleRetention(RetentionDelay);
+
+    return removed;
+}
+
+QStringList SqliteBackend::removeByApp(const QString &appName)
+{
+    flush();
+    completeMigration();
+
+    // no record has an app that is not in the dictionary
+    auto it = m_appIds.constFind(appName);
+    if (it == m_appIds.constEnd())
+        return QStringList();
+
+    if (!m_dbConnection.transaction()) {
+        qWarning() << "begin transaction failed: " << m_dbConnection.lastError().text();
+    }
+
+    QStringList removed;
+    m_idsByAppQuery.bindValue(":appid", it.value());
+    if (m_idsByAppQuery.exec()) {
+        while (m_idsByAppQuery.next()) {
+            removed << m_idsByAppQuery.value(0).toString();
+        }
+    } else {
+        qWarning() << "get ids of app" << appName << "failed: " << m_idsByAppQuery.lastError().text();
+    }
+    m_idsByAppQuery.finish();
+
+    m_removeByAppQuery.bindValue(":appid", it.value());
+    if (!m_removeByAppQuery.exec()) {
+        qWarning() << "remove values of app" << appName << "failed: " << m_removeByAppQuery.lastError().text();
+        m_dbConnection.rollback();
+        return QStringList();
+    }
+
+    if (!m_dbConnection.commit()) {
+        qWarning() << "commit transaction failed: " << m_dbConnection.lastError().text();
+        m_dbConnection.rollback();
+        return QStringList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "remove values of app" << appName << "done, count:" << removed.size();
+#endif
+    }
+
+    m_pruneDictionaries = true;
+    scheduleRetention(RetentionDelay);
+
+    return removed;
+}
+
+void SqliteBackend::removeAll()
+{
+    flush();
+
+    // the records a failed flush kept for the next one go too
+    m_pendingRecords.clear();
+    m_flushFailures = 0;
+
+    // the records not migrated yet, the emptied tables are dropped by the next migration step
+    for (const QString &table : m_migrationSources) {
+        if (!m_query.exec(QString("DELETE FROM %1").arg(table))) {
+            qWarning() << "remove all from" << table << "failed: " << m_query.lastError().text();
+        }
+    }
+
+    m_query.prepare(QString("DELETE FROM %1").arg(TableName_v4));
+
+    if (!m_query.exec()) {
+        qWarning() << "remove all from database failed: " << m_query.lastError().text();
+        return;
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "remove all done";
+#endif
+    }
+
+    for (const QString &table : { TableName_apps, TableName_icons }) {
+        if (!m_query.exec(QString("DELETE FROM %1").arg(table))) {
+            qWarning() << "remove all from" << table << "failed: " << m_query.lastError().text();
+        }
+    }
+    m_appIds.clear();
+    m_iconIds.clear();
+
+    // the removals logged by the trigger are covered by a single Cleared change
+    if (!m_query.exec(QString("DELETE FROM %1").arg(TableName_changes))
+            || !m_query.exec(QString("INSERT INTO %1 (%2) VALUES (%3)")
+                             .arg(TableName_changes, ColumnOperation).arg(NotificationChange::Cleared))) {
+        qWarning() << "reset change log failed: " << m_query.lastError().text();
+    }
+
+    // the unused space is given back by incremental vacuum steps, not by a full VACUUM
+    scheduleRetention(0);
+}
+
+NotificationRecordList SqliteBackend::getAll()
+{
+    flush();
+    completeMigration();
+
+    if (!m_getAllQuery.exec()) {
+        qWarning() << "get all from database failed: " << m_getAllQuery.lastError().text();
+        return NotificationRecordList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "get all done";
+#endif
+    }
+
+    return readRecords(m_getAllQuery);
+}
+
+NotificationRecordList SqliteBackend::getById(const QString &id)
+{
+    flush();
+    completeMigration();
+
+    m_getByIdQuery.bindValue(":id", id);
+
+    if (!m_getByIdQuery.exec()) {
+        qWarning() << "get data by id:" << id << "failed: " << m_getByIdQuery.lastError().text();
+        return NotificationRecordList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "get data by id:" << id << "done";
+#endif
+    }
+
+    const NotificationRecordList records = readRecords(m_getByIdQuery);
+    if (records.size() > 1) {
+        qWarning() << "more than one data has been obtained by id:" << id;
+    }
+
+    return records;
+}
+
+NotificationRecordList SqliteBackend::getPage(int rowCount, const QString &cursorId, bool newestFirst)
+{
+    flush();
+    completeMigration();
+
+    // an empty cursor starts from the newest or the oldest record
+    QSqlQuery &query = newestFirst ? m_pageNewestFirstQuery : m_pageOldestFirstQuery;
+    if (cursorId.isEmpty()) {
+        query.bindValue(":ctime", newestFirst ? std::numeric_limits<qint64>::max() : std::numeric_limits<qint64>::min());
+        query.bindValue(":cursor", newestFirst ? std::numeric_limits<qint64>::max() : qint64(0));
+    } else {
+        // the time of the cursor, or of the record before it by id if it has been removed since
+        qint64 ctime = std::numeric_limits<qint64>::min();
+        m_cursorTimeQuery.bindValue(":id", cursorId.toLongLong());
+        if (!m_cursorTimeQuery.exec()) {
+            qWarning() << "get time of cursor" << cursorId << "failed: " << m_cursorTimeQuery.lastError().text();
+        } else if (m_cursorTimeQuery.next()) {
+            ctime = m_cursorTimeQuery.value(0).toLongLong();
+        }
+        m_cursorTimeQuery.finish();
+
+        query.bindValue(":ctime", ctime);
+        query.bindValue(":cursor", cursorId.toLongLong());
+    }
+    query.bindValue(":rowCount", rowCount);
+
+    if (!query.exec()) {
+        qWarning() << "get page from database failed: " << query.lastError().text();
+        return NotificationRecordList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "get page done";
+#endif
+    }
+
+    return readRecords(query);
+}
+
+NotificationRecordList SqliteBackend::search(const QString &text, int limit, int offset)
+{
+    flush();
+    completeMigration();
+
+    if (m_fullTextSearch) {
+        // every word is matched as a quoted prefix, so nothing typed by the user is taken as query syntax
+        QStringList terms;
+        for (QString word : searchWords(text)) {
+            terms << "\"" + word.replace("\"", "\"\"") + "\"*";
+        }
+
+        if (terms.isEmpty())
+            return NotificationRecordList();
+
+        m_searchQuery.bindValue(":query", terms.join(" "));
+    } else {
+        m_searchQuery.bindValue(":query", "%" + text + "%");
+    }
+    m_searchQuery.bindValue(":limit", limit);
+    m_searchQuery.bindValue(":offset", offset);
+
+    if (!m_searchQuery.exec()) {
+        qWarning() << "search" << text << "failed: " << m_searchQuery.lastError().text();
+        return NotificationRecordList();
+    } else {
+#ifdef QT_DEBUG
+        qDebug() << "search" << text << "done";
+#endif
+    }
+
+    return readRecords(m_searchQuery);
+}
+
+NotificationChangeList SqliteBackend::changesSince(qint64 seq, int limit)
+{
+    flush();
+    completeMigration();
+
+    NotificationChangeList changes;
+
+    NotificationChange first;
+    if (!m_firstChangeQuery.exec()) {
+        qWarning() << "get first change failed: " << m_firstChangeQuery.lastError().text();
+        return changes;
+    }
+    if (m_firstChangeQuery.next()) {
+        first.seq = m_firstChangeQuery.value(0).toLongLong();
+        first.operation = NotificationChange::Operation(m_firstChangeQuery.value(1).toInt());
+    }
+    m_firstChangeQuery.finish();
+
+    const qint64 lastSeq = queryLastSeq();
+    if (!logCovers(seq, first, lastSeq)) {
+        changes << NotificationChange(lastSeq, NotificationChange::Reset);
+        return changes;
+    }
+
+    m_changesQuery.bindValue(":seq", seq);
+    m_changesQuery.bindValue(":limit", limit);
+
+    if (!m_changesQuery.exec()) {
+        qWarning() << "get changes since" << seq << "failed: " << m_changesQuery.lastError().text();
+        return changes;
+    }
+
+    while (m_changesQuery.next()) {
+        NotificationChange change(m_changesQuery.value(0).toLongLong(),
+                                  NotificationChange::Operation(m_changesQuery.value(1).toInt()),
+                                  m_changesQuery.value(2).toUInt());
+        // NULL when the record is gone or the change is not an addition
+        if (!m_changesQuery.isNull(3)) {
+            change.record = readRecord(m_changesQuery, 3);
+        }
+        changes << change;
+    }
+    m_changesQuery.finish();
+
+    return changes;
+}
+
+void SqliteBackend::attemptCreateTable()
+{
+    // most records come from a few apps, their names and icons are only stored once
+    for (const QString &table : { TableName_apps, TableName_icons }) {
+        if (!m_query.exec(QString("CREATE TABLE IF NOT EXISTS %1 (%2 INTEGER PRIMARY KEY, %3 TEXT UNIQUE)")
+                          .arg(table, ColumnId, ColumnValue))) {
+            qWarning() << "create table" << table << "failed" << m_query.lastError().text();
+        }
+    }
+
+    m_query.prepare(QString("CREATE TABLE IF NOT EXISTS %1"
+                          "("
+                          "%2 INTEGER PRIMARY KEY   AUTOINCREMENT,"
+                          "%3 INTEGER,"
+                          "%4 TEXT,"
+                          "%5 TEXT,"
+                          "%6 INTEGER,"
+                          "%7 INTEGER,"
+                          "%8 INTEGER,"
+                          "%9 INTEGER,"
+                          "%10 BLOB"
+                          ");").arg(TableName_v4,
+                                ColumnId, ColumnIconId, ColumnSummary,
+                                ColumnBody, ColumnAppId, ColumnCTime,
+                                ColumnReplacesId, ColumnTimeout)
+                    .arg(ColumnBodyData));
+
+    if (!m_query.exec()) {
+        qWarning() << "create table failed" << m_query.lastError().text();
+    }
+
+    // for the age limit of the retention policy and the queries of a single app
+    if (!m_query.exec(QString("CREATE INDEX IF NOT EXISTS %1_%2 ON %1 (%2)").arg(TableName_v4, ColumnCTime))
+            || !m_query.exec(QString("CREATE INDEX IF NOT EXISTS %1_%2_%3 ON %1 (%2, %3)").arg(TableName_v4, ColumnAppId, ColumnCTime))) {
+        qWarning() << "create index failed" << m_query.lastError().text();
+    }
+
+    if (!m_query.exec(QString("CREATE VIEW IF NOT EXISTS %1 AS SELECT "
+                              "n.%2 AS %2, i.%3 AS %4, n.%5 AS %5, n.%6 AS %6, a.%3 AS %7, "
+                              "n.%8 AS %8, n.%9 AS %9, n.%10 AS %10, n.%11 AS %11 "
+                              "FROM %12 n LEFT JOIN %13 a ON a.%2 = n.%14 LEFT JOIN %15 i ON i.%2 = n.%16")
+                      .arg(TableName_view, ColumnId, ColumnValue, ColumnIcon, ColumnSummary,
+                           ColumnBody, ColumnAppName, ColumnCTime, ColumnReplacesId)
+                      .arg(ColumnTimeout, ColumnBodyData, TableName_v4, TableName_apps,
+                           ColumnAppId, TableName_icons, ColumnIconId))) {
+        qWarning() << "create view failed" << m_query.lastError().text();
+    }
+}
+
+void SqliteBackend::attemptCreateChangeLog()
+{
+    bool exists = false;
+    if (m_query.exec(QString("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = '%1'").arg(TableName_changes))) {
+        exists = m_query.next();
+        m_query.finish();
+    }
+
+    // AUTOINCREMENT, so the seqs are not used again after the log is emptied
+    if (!m_query.exec(QString("CREATE TABLE IF NOT EXISTS %1 (%2 INTEGER PRIMARY KEY AUTOINCREMENT, %3 INTEGER, %4 INTEGER)")
+                      .arg(TableName_changes, ColumnSeq, ColumnOperation, ColumnRecordId))) {
+        qWarning() << "create change log failed: " << m_query.lastError().text();
+        return;
+    }
+
+    // every change of notifications4 is logged, including the migrated records and the expired ones
+    const QStringList triggers {
+        QString("CREATE TRIGGER IF NOT EXISTS %1_insert AFTER INSERT ON %2 BEGIN "
+                "INSERT INTO %1 (%3, %4) VALUES (%5, new.%6); "
+                "END").arg(TableName_changes, TableName_v4, ColumnOperation, ColumnRecordId)
+                      .arg(NotificationChange::Added).arg(ColumnId),
+        QString("CREATE TRIGGER IF NOT EXISTS %1_delete AFTER DELETE ON %2 BEGIN "
+                "INSERT INTO %1 (%3, %4) VALUES (%5, old.%6); "
+                "END").arg(TableName_changes, TableName_v4, ColumnOperation, ColumnRecordId)
+                      .arg(NotificationChange::Removed).arg(ColumnId)
+    };
+
+    for (const QString &trigger : triggers) {
+        if (!m_query.exec(trigger)) {
+            qWarning() << "create change log trigger failed: " << m_query.lastError().text();
+        }
+    }
+
+    if (exists)
+        return;
+
+    // a new log starts with the records there are, like one after removeAll()
+    if (!m_query.exec(QString("INSERT INTO %1 (%2) VALUES (%3)")
+                      .arg(TableName_changes, ColumnOperation).arg(NotificationChange::Cleared))
+            || !m_query.exec(QString("INSERT INTO %1 (%2, %3) SELECT %4, %5 FROM %6 ORDER BY %5")
+                             .arg(TableName_changes, ColumnOperation, ColumnRecordId)
+                             .arg(NotificationChange::Added).arg(ColumnId, TableName_v4))) {
+        qWarning() << "fill change log failed: " << m_query.lastError().text();
+    }
+}
+
+void SqliteBackend::loadDictionaries()
+{
+    m_appIds.clear();
+    m_iconIds.clear();
+
+    for (const QString &table : { TableName_apps, TableName_icons }) {
+        QHash<QString, qint64> &ids = table == TableName_apps ? m_appIds : m_iconIds;
+
+        if (!m_query.exec(QString("SELECT %1, %2 FROM %3").arg(ColumnId, ColumnValue, table))) {
+            qWarning() << "load" << table << "failed: " << m_query.lastError().text();
+            continue;
+        }
+
+        while (m_query.next()) {
+            ids.insert(m_query.value(1).toString(), m_query.value(0).toLongLong());
+        }
+        m_query.finish();
+    }
+}
+
+QVariant SqliteBackend::intern(QSqlQuery &query, QHash<QString, qint64> &ids, const QString &value)
+{
+    // the dictionaries are only read at startup, known values never need a query
+    auto it = ids.constFind(value);
+    if (it != ids.constEnd())
+        return it.value();
+
+    query.bindValue(":value", value);
+    if (!query.exec()) {
+        qWarning() << "add" << value.left(64) << "to dictionary failed: " << query.lastError().text();
+        return QVariant(QVariant::LongLong);
+    }
+
+    const qint64 id = query.lastInsertId().toLongLong();
+    ids.insert(value, id);
+
+    return id;
+}
+
+void SqliteBackend::pruneDictionaries()
+{
+    m_pruneDictionaries = false;
+
+    const QList<QPair<QString, QString>> references {
+        { TableName_apps, ColumnAppId },
+        { TableName_icons, ColumnIconId }
+    };
+
+    int removed = 0;
+    for (const auto &reference : references) {
+        if (!m_query.exec(QString("DELETE FROM %1 WHERE %2 NOT IN (SELECT %3 FROM %4 WHERE %3 IS NOT NULL)")
+                          .arg(reference.first, ColumnId, reference.second, TableName_v4))) {
+            qWarning() << "prune" << reference.first << "failed: " << m_query.lastError().text();
+            continue;
+        }
+        removed += m_query.numRowsAffected();
+    }
+
+    if (removed > 0) {
+        loadDictionaries();
+    }
+
+#ifdef QT_DEBUG
+    qDebug() << "prune dictionaries removed:" << removed;
+#endif
+}
+
+uint SqliteBackend::attemptMigrate(uint firstLegacyId)
+{
+    if (pragmaValue("user_version") >= SchemaVersion)
+        return 0;
+
+    // the search indexes of the old tables are not kept, notifications4 gets its own.
+    // the triggers go first, deleting migrated records would fail without the index.
+    for (const QString &searchTable : { TableName_search_v2, TableName_search_v3 }) {
+        for (const QString &trigger : { "insert", "delete", "update" }) {
+            m_query.exec(QString("DROP TRIGGER IF EXISTS %1_%2").arg(searchTable, trigger));
+        }
+        if (!m_query.exec(QString("DROP TABLE IF EXISTS %1").arg(searchTable))) {
+            qWarning() << "drop search index failed: " << m_query.lastError().text();
+        }
+    }
+
+    uint legacyCount = 0;
+    for (const QString &table : { TableName_v3, TableName_v2, TableName }) {
+        if (!m_query.exec(QString("SELECT count() FROM %1").arg(table))) {
+            // the table does not exist
+            continue;
+        }
+
+        if (m_query.next() && table == TableName) {
+            legacyCount = m_query.value(0).toUInt();
+        }
+        m_query.finish();
+
+        m_migrationSources << table;
+    }
+
+    m_nextLegacyId = firstLegacyId;
+
+    if (m_migrationSources.isEmpty()) {
+        setSchemaVersion();
+    } else {
+        post([this] { migrateBatch(); });
+    }
+
+    return legacyCount;
+}
+
+void SqliteBackend::migrateBatch()
+{
+    if (m_migrationSources.isEmpty())
+        return;
+
+    const QString source = m_migrationSources.first();
+
+    // the columns of the first table version are not known for sure, missing ones are read as NULL
+    QStringList sourceColumns;
+    if (m_query.exec(QString("PRAGMA table_info(%1)").arg(source))) {
+        while (m_query.next()) {
+            sourceColumns << m_query.value(1).toString();
+        }
+        m_query.finish();
+    }
+
+    // in the column order of readRecords()
+    QStringList columns { "rowid" };
+    for (const QString &column : { ColumnIcon, ColumnSummary, ColumnBody, ColumnAppName,
+                                   ColumnCTime, ColumnReplacesId, ColumnTimeout, ColumnBodyData }) {
+        columns << (sourceColumns.contains(column) ? column : "NULL");
+    }
+
+    if (!m_dbConnection.transaction()) {
+        qWarning() << "begin transaction failed: " << m_dbConnection.lastError().text();
+    }
+
+    QSqlQuery select(m_dbConnection);
+    select.setForwardOnly(true);
+    if (!select.exec(QString("SELECT %1 FROM %2 ORDER BY rowid LIMIT %3")
+                     .arg(columns.join(", "), source).arg(MigrationBatch))) {
+        qWarning() << "read records of" << source << "failed: " << select.lastError().text();
+    }
+
+    const NotificationRecordList records = readRecords(select);
+    const int count = records.size();
+    const qint64 lastRowId = count > 0 ? records.last().id : 0;
+
+    // the ids of the later versions are kept, the clients may know them
+    for (NotificationRecord record : records) {
+        if (source == TableName) {
+            record.id = m_nextLegacyId++;
+        }
+
+        insertRecord(record);
+    }
+
+    if (count > 0 && !m_query.exec(QString("DELETE FROM %1 WHERE rowid <= %2").arg(source).arg(lastRowId))) {
+        qWarning() << "remove migrated records of" << source << "failed: " << m_query.lastError().text();
+    }
+
+    if (!m_dbConnection.commit()) {
+        qWarning() << "commit transaction failed: " << m_dbConnection.lastError().text();
+        m_dbConnection.rollback();
+        loadDictionaries();
+        return;
+    }
+
+    if (count < MigrationBatch) {
+        if (!m_query.exec(QString("DROP TABLE %1").arg(source))) {
+            qWarning() << "drop table" << source << "failed: " << m_query.lastError().text();
+        }
+        m_migrationSources.removeFirst();
+
+#ifdef QT_DEBUG
+        qDebug() << "migrate" << source << "done";
+#endif
+    }
+
+    if (m_migrationSources.isEmpty()) {
+        setSchemaVersion();
+    } else {
+        // other requests run between the batches
+        post([this] { migrateBatch(); });
+    }
+}
+
+void SqliteBackend::completeMigration()
+{
+    while (!m_migrationSources.isEmpty()) {
+        migrateBatch();
+    }
+}
+
+void SqliteBackend::setSchemaVersion()
+{
+    if (!m_query.exec(QString("PRAGMA user_version = %1").arg(SchemaVersion))) {
+        qWarning() << "set schema version failed: " << m_query.lastError().text();
+    }
+}
+
+void SqliteBackend::attemptCreateSearchIndex()
+{
+    // records added while the triggers did not exist are missing from the index
+    bool triggersExist = false;
+    if (m_query.exec(QString("SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = '%1_insert'").arg(TableName_search))) {
+        triggersExist = m_query.next();
+        m_query.finish();
+    }
+
+    // an external content table, the text is only stored in notifications4 and apps
+    if (!m_query.exec(QString("CREATE VIRTUAL TABLE IF NOT EXISTS %1 USING fts5(%2, %3, %4, content='%5', content_rowid='%6')")
+                      .arg(TableName_search, ColumnSummary, ColumnBody, ColumnAppName, TableName_view, ColumnId))) {
+        qWarning() << "create search index failed, searching without it: " << m_query.lastError().text();
+
+        // the triggers would make every insert fail without fts5
+        m_query.exec(QString("DROP TRIGGER IF EXISTS %1_insert").arg(TableName_search));
+        m_query.exec(QString("DROP TRIGGER IF EXISTS %1_delete").arg(TableName_search));
+        m_query.exec(QString("DROP TRIGGER IF EXISTS %1_update").arg(TableName_search));
+        return;
+    }
+
+    const QString columns = QString("%1, %2, %3").arg(ColumnSummary, ColumnBody, ColumnAppName);
+    // the apps are only pruned after their records are gone, so the name is still there in the delete trigger
+    const QString newValues = QString("new.%1, new.%2, new.%3, (SELECT %4 FROM %5 WHERE %1 = new.%6)")
+            .arg(ColumnId, ColumnSummary, ColumnBody, ColumnValue, TableName_apps, ColumnAppId);
+    const QString oldValues = QString("old.%1, old.%2, old.%3, (SELECT %4 FROM %5 WHERE %1 = old.%6)")
+            .arg(ColumnId, ColumnSummary, ColumnBody, ColumnValue, TableName_apps, ColumnAppId);
+
+    const QStringList triggers {
+        QString("CREATE TRIGGER IF NOT EXISTS %1_insert AFTER INSERT ON %2 BEGIN "
+                "INSERT INTO %1 (rowid, %3) VALUES (%4); "
+                "END").arg(TableName_search, TableName_v4, columns, newValues),
+        QString("CREATE TRIGGER IF NOT EXISTS %1_delete AFTER DELETE ON %2 BEGIN "
+                "INSERT INTO %1 (%1, rowid, %3) VALUES ('delete', %4); "
+                "END").arg(TableName_search, TableName_v4, columns, oldValues),
+        QString("CREATE TRIGGER IF NOT EXISTS %1_update AFTER UPDATE ON %2 BEGIN "
+                "INSERT INTO %1 (%1, rowid, %3) VALUES ('delete', %4); "
+                "INSERT INTO %1 (rowid, %3) VALUES (%5); "
+                "END").arg(TableName_search, TableName_v4, columns, oldValues, newValues)
+    };
+
+    for (const QString &trigger : triggers) {
+        if (!m_query.exec(trigger)) {
+            qWarning() << "create search index trigger failed: " << m_query.lastError().text();
+            return;
+        }
+    }
+
+    m_fullTextSearch = true;
+
+    if (!triggersExist) {
+        post([this] {
+            if (!m_query.exec(QString("INSERT INTO %1 (%1) VALUES ('rebuild')").arg(TableName_search))) {
+                qWarning() << "rebuild search index failed: " << m_query.lastError().text();
+            }
+        });
+    }
+}
+
+void SqliteBackend::prepareQueries()
+{
+    // the statements used for every request are only prepared once per connection
+    // readRecords() expects the columns in this order
+    const QString columns = QString("%1, %2, %3, %4, %5, %6, %7, %8, %9")
+            .arg(ColumnId, ColumnIcon, ColumnSummary, ColumnBody, ColumnAppName,
+                 ColumnCTime, ColumnReplacesId, ColumnTimeout, ColumnBodyData);
+
+    prepareQuery(m_insertQuery, QString("INSERT INTO %1 (%2, %3, %4, %5, %6, %7, %8, %9, %10)"
+                                        "VALUES (:id, :iconid, :summary, :body, :appid, :ctime, :replacesid, :timeout, :bodydata)")
+                 .arg(TableName_v4, ColumnId, ColumnIconId, ColumnSummary, ColumnBody,
+                      ColumnAppId, ColumnCTime, ColumnReplacesId, ColumnTimeout)
+                 .arg(ColumnBodyData));
+
+    prepareQuery(m_internAppQuery, QString("INSERT INTO %1 (%2) VALUES (:value)").arg(TableName_apps, ColumnValue));
+    prepareQuery(m_internIconQuery, QString("INSERT INTO %1 (%2) VALUES (:value)").arg(TableName_icons, ColumnValue));
+
+    prepareQuery(m_removeQuery, QString("DELETE FROM %1 WHERE ID = (:id)").arg(TableName_v4));
+
+    // both use the index on AppId and CTime
+    prepareQuery(m_idsByAppQuery, QString("SELECT %1 FROM %2 WHERE %3 = (:appid)").arg(ColumnId, TableName_v4, ColumnAppId));
+    prepareQuery(m_removeByAppQuery, QString("DELETE FROM %1 WHERE %2 = (:appid)").arg(TableName_v4, ColumnAppId));
+
+    // the records are read through the view, in the same shape as before the dictionaries
+    prepareQuery(m_getAllQuery, QString("SELECT %1 FROM %2 ORDER BY %3, ID").arg(columns, TableName_view, ColumnCTime));
+
+    prepareQuery(m_getByIdQuery, QString("SELECT %1 FROM %2 WHERE ID = (:id)").arg(columns, TableName_view));
+
+    // keyset pagination in the order of CTime and ID, the records of the first table version
+    // got their ids after newer ones. the index on CTime holds the rowid as well, so neither
+    // of them scans the skipped records.
+    prepareQuery(m_pageNewestFirstQuery, QString("SELECT %1 FROM %2 WHERE %3 < (:ctime) OR (%3 = (:ctime) AND ID < (:cursor)) "
+                                                 "ORDER BY %3 DESC, ID DESC LIMIT (:rowCount)")
+                 .arg(columns, TableName_view, ColumnCTime));
+
+    prepareQuery(m_pageOldestFirstQuery, QString("SELECT %1 FROM %2 WHERE %3 > (:ctime) OR (%3 = (:ctime) AND ID > (:cursor)) "
+                                                 "ORDER BY %3 ASC, ID ASC LIMIT (:rowCount)")
+                 .arg(columns, TableName_view, ColumnCTime));
+
+    prepareQuery(m_cursorTimeQuery, QString("SELECT %1 FROM %2 WHERE ID <= (:id) ORDER BY ID DESC LIMIT 1")
+                 .arg(ColumnCTime, TableName_v4));
+
+    if (m_fullTextSearch) {
+        // ranked by bm25(), the best match first
+        prepareQuery(m_searchQuery, QString("SELECT %1 FROM %2 JOIN %3 ON %3.%4 = %2.rowid "
+                                            "WHERE %2 MATCH (:query) ORDER BY rank LIMIT (:limit) OFFSET (:offset)")
+                     .arg(qualifiedColumns(columns, TableName_view), TableName_search, TableName_view, ColumnId));
+    } else {
+        prepareQuery(m_searchQuery, QString("SELECT %1 FROM %2 WHERE %3 LIKE (:query) OR %4 LIKE (:query) OR %5 LIKE (:query) "
+                                            "ORDER BY %6 DESC, ID DESC LIMIT (:limit) OFFSET (:offset)")
+                     .arg(columns, TableName_view, ColumnSummary, ColumnBody, ColumnAppName, ColumnCTime));
+    }
+
+    // retention, the oldest records are removed first and at most :batch at a time,
+    // in the order of getPage()
+    prepareQuery(m_countBoundaryQuery, QString("SELECT %1, ID FROM %2 ORDER BY %1 DESC, ID DESC LIMIT 1 OFFSET (:maxCount)")
+                 .arg(ColumnCTime, TableName_v4));
+
+    prepareQuery(m_removeUpToQuery, QString("DELETE FROM %1 WHERE ID IN "
+                                            "(SELECT ID FROM %1 WHERE %2 < (:ctime) OR (%2 = (:ctime) AND ID <= (:id)) "
+                                            "ORDER BY %2, ID LIMIT (:batch))")
+                 .arg(TableName_v4, ColumnCTime));
+
+    prepareQuery(m_removeOlderQuery, QString("DELETE FROM %1 WHERE ID IN "
+                                             "(SELECT ID FROM %1 WHERE %2 < (:ctime) ORDER BY %2, ID LIMIT (:batch))")
+                 .arg(TableName_v4, ColumnCTime));
+
+    prepareQuery(m_changesQuery, QString("SELECT c.%1, c.%2, c.%3, %4 FROM %5 c LEFT JOIN %6 ON c.%2 = %7 AND %6.%8 = c.%3 "
+                                         "WHERE c.%1 > (:seq) ORDER BY c.%1 LIMIT (:limit)")
+                 .arg(ColumnSeq, ColumnOperation, ColumnRecordId, qualifiedColumns(columns, TableName_view),
+                      TableName_changes, TableName_view).arg(NotificationChange::Added).arg(ColumnId));
+
+    prepareQuery(m_firstChangeQuery, QString("SELECT %1, %2 FROM %3 ORDER BY %1 LIMIT 1")
+                 .arg(ColumnSeq, ColumnOperation, TableName_changes));
+
+    // only the newest ChangeLogSize changes are kept
+    prepareQuery(m_trimChangesQuery, QString("DELETE FROM %1 WHERE %2 <= (SELECT max(%2) FROM %1) - (:size)")
+                 .arg(TableName_changes, ColumnSeq));
+
+    prepareQuery(m_removeOldestQuery, QString("DELETE FROM %1 WHERE ID IN "
+                                              "(SELECT ID FROM %1 ORDER BY %2, ID LIMIT (:batch))")
+                 .arg(TableName_v4, ColumnCTime));
+
+    // the change log has the ids of the records removed by the retention policy
+    prepareQuery(m_removedSinceQuery, QString("SELECT %1 FROM %2 WHERE %3 > (:seq) AND %4 = %5 ORDER BY %3")
+                 .arg(ColumnRecordId, TableName_changes, ColumnSeq, ColumnOperation)
+                 .arg(NotificationChange::Removed));
+}
+
+void SqliteBackend::prepareQuery(QSqlQuery &query, const QString &sql)
+{
+    query = QSqlQuery(m_dbConnection);
+    query.setForwardOnly(true);
+
+    if (!query.prepare(sql)) {
+        qWarning() << "prepare query failed: " << query.lastError().text() << sql;
+    }
+}
+
+NotificationRecordList SqliteBackend::readRecords(QSqlQuery &query)
+{
+    NotificationRecordList records;
+    while (query.next()) {
+        records << readRecord(query);
+    }
+    query.finish();
+
+    return records;
+}
+
+NotificationRecord SqliteBackend::readRecord(const QSqlQuery &query, int column)
+{
+    NotificationRecord record;
+    record.id = query.value(column).toUInt();
+    record.appIcon = query.value(column + 1).toString();
+    record.summary = query.value(column + 2).toString();
+    record.body = query.value(column + 3).toString();
+    record.appName = query.value(column + 4).toString();
+    record.ctime = query.value(column + 5).toLongLong();
+    record.replacesId = query.value(column + 6).toUInt();
+    record.timeout = query.value(column + 7).toInt();
+
+    // only the records that are read pay for the decompression
+    const QByteArray bodyData = query.value(column + 8).toByteArray();
+    if (!bodyData.isEmpty()) {
+        record.body = QString::fromUtf8(qUncompress(bodyData));
+    }
+
+    return record;
+}
+
+void SqliteBackend::enableIncrementalVacuum()
+{
+    // 2 is INCREMENTAL
+    if (pragmaValue("auto_vacuum") != 2) {
+        // changing auto_vacuum of an existing database only takes effect after a VACUUM,
+        // it is needed only once, and is done after the database has been opened.
+        if (!m_query.exec("PRAGMA auto_vacuum = INCREMENTAL") || !m_query.exec("VACUUM")) {
+            qWarning() << "enable incremental vacuum failed: " << m_query.lastError().text();
+            return;
+        }
+    }
+
+    m_incrementalVacuum = pragmaValue("auto_vacuum") == 2;
+}
+
+void SqliteBackend::scheduleRetention(int msec)
+{
+    if (!m_retentionTimer->isActive() || m_retentionTimer->remainingTime() > msec) {
+        m_retentionTimer->start(msec);
+    }
+}
+
+void SqliteBackend::enforceRetention()
+{
+    flush();
+
+    const qint64 lastSeq = queryLastSeq();
+    int removed = 0;
+
+    if (m_maxCount > 0) {
+        // the newest record that is not kept
+        m_countBoundaryQuery.bindValue(":maxCount", m_maxCount);
+        if (m_countBoundaryQuery.exec() && m_countBoundaryQuery.next()) {
+            const qint64 ctime = m_countBoundaryQuery.value(0).toLongLong();
+            const qint64 id = m_countBoundaryQuery.value(1).toLongLong();
+            m_countBoundaryQuery.finish();
+
+            m_removeUpToQuery.bindValue(":ctime", ctime);
+            m_removeUpToQuery.bindValue(":id", id);
+            removed += removeBatch(m_removeUpToQuery);
+        } else {
+            m_countBoundaryQuery.finish();
+        }
+    }
+
+    if (m_maxDays > 0) {
+        const qint64 deadline = QDateTime::currentMSecsSinceEpoch() - qint64(m_maxDays) * 24 * 60 * 60 * 1000;
+        m_removeOlderQuery.bindValue(":ctime", deadline);
+        removed += removeBatch(m_removeOlderQuery);
+    }
+
+    if (m_maxSize > 0) {
+        const qint64 usedPages = pragmaValue("page_count") - pragmaValue("freelist_count");
+        if (usedPages * pragmaValue("page_size") > m_maxSize) {
+            removed += removeBatch(m_removeOldestQuery);
+        }
+    }
+
+    // before the changes are trimmed
+    const QStringList expired = removed > 0 ? queryRemovedSince(lastSeq) : QStringList();
+
+    m_trimChangesQuery.bindValue(":size", ChangeLogSize);
+    if (!m_trimChangesQuery.exec()) {
+        qWarning() << "trim change log failed: " << m_trimChangesQuery.lastError().text();
+    }
+
+    if (removed > 0) {
+        Q_EMIT RecordsExpired(expired);
+        m_pruneDictionaries = true;
+    } else if (m_pruneDictionaries) {
+        // once all expired records are gone
+        pruneDictionaries();
+    }
+
+    const bool freePagesLeft = incrementalVacuum();
+
+#ifdef QT_DEBUG
+    qDebug() << "retention removed:" << removed << "free pages left:" << freePagesLeft;
+#endif
+
+    if (removed > 0 || freePagesLeft) {
+        scheduleRetention(RetentionBatchInterval);
+    } else if (m_maxDays > 0) {
+        scheduleRetention(RetentionCheckInterval);
+    }
+}
+
+int SqliteBackend::removeBatch(QSqlQuery &query)
+{
+    query.bindValue(":batch", RetentionBatch);
+
+    if (!query.exec()) {
+        qWarning() << "remove expired records failed: " << query.lastError().text();
+        return 0;
+    }
+
+    return query.numRowsAffected();
+}
+
+bool SqliteBackend::incrementalVacuum()
+{
+    if (!m_incrementalVacuum)
+        return false;
+
+    if (!m_query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(VacuumPages))) {
+        qWarning() << "incremental vacuum failed: " << m_query.lastError().text();
+        return false;
+    }
+
+    // the pragma frees one page per step, so the statement has to be stepped to the end
+    while (m_query.next()) {}
+    m_query.finish();
+
+    return pragmaValue("freelist_count") > 0;
+}
+
+QStringList SqliteBackend::queryRemovedSince(qint64 seq)
+{
+    QStringList ids;
+
+    m_removedSinceQuery.bindValue(":seq", seq);
+    if (!m_removedSinceQuery.exec()) {
+        qWarning() << "get removed records failed: " << m_removedSinceQuery.lastError().text();
+        return ids;
+    }
+
+    while (m_removedSinceQuery.next()) {
+        ids << m_removedSinceQuery.value(0).toString();
+    }
+    m_removedSinceQuery.finish();
+
+    return ids;
+}
+
+qint64 SqliteBackend::pragmaValue(const QString &name)
+{
+    if (!m_query.exec(QString("PRAGMA %1").arg(name)) || !m_query.next()) {
+        qWarning() << "get pragma" << name << "failed: " << m_query.lastError().text();
+        m_query.finish();
+        return 0;
+    }
+
+    const qint64 value = m_query.value(0).toLongLong();
+    m_query.finish();
+
+    return value;
+}
+
+uint SqliteBackend::queryLastId()
+{
+    // AUTOINCREMENT keeps the largest id ever used in sqlite_sequence,
+    // so ids of removed records are not handed out again.
+    if (!m_query.exec(QString("SELECT max(seq) FROM sqlite_sequence WHERE name != '%1'").arg(TableName_changes))) {
+        qWarning() << "get last id failed: " << m_query.lastError().text();
+        return 0;
+    }
+
+    const uint lastId = m_query.next() ? m_query.value(0).toUInt() : 0;
+    m_query.finish();
+
+    return lastId;
+}
+
+qint64 SqliteBackend::queryLastSeq()
+{
+    if (!m_query.exec(QString("SELECT seq FROM sqlite_sequence WHERE name = '%1'").arg(TableName_changes))) {
+        qWarning() << "get last seq failed: " << m_query.lastError().text();
+        return 0;
+    }
+
+    const qint64 lastSeq = m_query.next() ? m_query.value(0).toLongLong() : 0;
+    m_query.finish();
+
+    return lastSeq;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2016 ~ 2018 Deepin Technology Co., Ltd.
+ *
+ * Author:     kirigaya <kirigaya@mkacg.com>
+ *
+ * Maintainer: listenerri <listenerri@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQLITEBACKEND_H
+#define SQLITEBACKEND_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QHash>
+#include <QVariant>
+
+#include "persistencebackend.h"
+
+class QTimer;
+
+// Keeps the records in a SQLite database, the default backend.
+class SqliteBackend : public PersistenceBackend
+{
+    Q_OBJECT
+public:
+    explicit SqliteBackend(const QString &databasePath, QObject *parent = 0);
+    ~SqliteBackend();
+
+    uint open() Q_DECL_OVERRIDE;
+    void setRetentionPolicy(int maxCount, int maxDays, qint64 maxSize) Q_DECL_OVERRIDE;
+
+    // bodies longer than threshold characters are written compressed, 0 disables it
+    void setBodyCompression(int threshold);
+
+    // the record is only written to the database by the next flush, which happens
+    // when enough records are pending or after a short delay.
+    void addOne(const NotificationRecord &record) Q_DECL_OVERRIDE;
+    void removeOne(const QString &id) Q_DECL_OVERRIDE;
+    QStringList removeMany(const QStringList &ids) Q_DECL_OVERRIDE;
+    QStringList removeByApp(const QString &appName) Q_DECL_OVERRIDE;
+    void removeAll() Q_DECL_OVERRIDE;
+
+    // write all pending records to the database in a single transaction
+    void flush() Q_DECL_OVERRIDE;
+
+    NotificationRecordList getAll() Q_DECL_OVERRIDE;
+    NotificationRecordList getById(const QString &id) Q_DECL_OVERRIDE;
+    NotificationRecordList getPage(int rowCount, const QString &cursorId, bool newestFirst) Q_DECL_OVERRIDE;
+
+    // falls back to a plain substring search without fts5, compressed bodies
+    // are only matched against the prefix kept in Body.
+    NotificationRecordList search(const QString &text, int limit, int offset) Q_DECL_OVERRIDE;
+
+    NotificationChangeList changesSince(qint64 seq, int limit) Q_DECL_OVERRIDE;
+
+private:
+    void attemptCreateTable();
+    void attemptCreateChangeLog();
+    void loadDictionaries();
+    // return the id of value in the dictionary of query, adding it when it is new
+    QVariant intern(QSqlQuery &query, QHash<QString, qint64> &ids, const QString &value);
+    void pruneDictionaries();
+    // return the number of records whose ids are given by the migration
+    uint attemptMigrate(uint firstLegacyId);
+    void migrateBatch();
+    void completeMigration();
+    void setSchemaVersion();
+    bool insertRecord(const NotificationRecord &record);
+    // keep the records of a failed flush pending for the next one
+    void retryFlush(const QList<NotificationRecord> &records);
+    void attemptCreateSearchIndex();
+    void prepareQueries();
+    void prepareQuery(QSqlQuery &query, const QString &sql);
+    NotificationRecordList readRecords(QSqlQuery &query);
+    // the record in the columns of readRecords() starting at column
+    NotificationRecord readRecord(const QSqlQuery &query, int column = 0);
+
+    void enableIncrementalVacuum();
+    void scheduleRetention(int msec);
+    void enforceRetention();
+    int removeBatch(QSqlQuery &query);
+    // return true if there are still free pages in the database
+    bool incrementalVacuum();
+    qint64 pragmaValue(const QString &name);
+    // the ids of the records removed since the change seq
+    QStringList queryRemovedSince(qint64 seq);
+
+    uint queryLastId();
+    qint64 queryLastSeq();
+
+private:
+    QString m_databasePath;
+    QSqlDatabase m_dbConnection;
+    QSqlQuery m_query;
+
+    QSqlQuery m_insertQuery;
+    QSqlQuery m_removeQuery;
+    QSqlQuery m_getAllQuery;
+    QSqlQuery m_getByIdQuery;
+    QSqlQuery m_pageNewestFirstQuery;
+    QSqlQuery m_pageOldestFirstQuery;
+    QSqlQuery m_cursorTimeQuery;
+    QSqlQuery m_countBoundaryQuery;
+    QSqlQuery m_removeUpToQuery;
+    QSqlQuery m_removeOlderQuery;
+    QSqlQuery m_removeOldestQuery;
+    QSqlQuery m_searchQuery;
+    QSqlQuery m_idsByAppQuery;
+    QSqlQuery m_removeByAppQuery;
+    QSqlQuery m_internAppQuery;
+    QSqlQuery m_internIconQuery;
+    QSqlQuery m_changesQuery;
+    QSqlQuery m_firstChangeQuery;
+    QSqlQuery m_trimChangesQuery;
+    QSqlQuery m_removedSinceQuery;
+
+    QList<NotificationRecord> m_pendingRecords;
+    QTimer *m_flushTimer;
+    int m_flushFailures;
+
+    int m_maxCount;
+    int m_maxDays;
+    qint64 m_maxSize;
+    bool m_incrementalVacuum;
+    QTimer *m_retentionTimer;
+
+    bool m_fullTextSearch;
+
+    QStringList m_migrationSources;
+    uint m_nextLegacyId;
+
+    int m_compressThreshold;
+
+    // the ids of the app names and icons, the same as in the dictionary tables
+    QHash<QString, qint64> m_appIds;
+    QHash<QString, qint64> m_iconIds;
+    bool m_pruneDictionaries;
+};
+
+#endif // SQLITEBACKEND_H
@@ -1,17 +1,28 @@
 HEADERS += \
     $$PWD/bubble.h \
     $$PWD/bubblemanager.h \
+    $$PWD/delayedreply.h \
     $$PWD/notifications_dbus_adaptor.h \
     $$PWD/dbus_daemon_interface.h \
     $$PWD/notificationentity.h \
+    $$PWD/notificationrecord.h \
     $$PWD/dbuslogin1manager.h \
     $$PWD/actionbutton.h \
     $$PWD/appicon.h\
     $$PWD/dbusdock_interface.h \
     $$PWD/dbuscontrol.h \
+    $$PWD/notificationhistory.h \
     $$PWD/persistence.h \
+    $$PWD/persistencebackend.h \
+    $$PWD/sqlitebackend.h \
+    $$PWD/memorybackend.h \
+    $$PWD/logbackend.h \
     $$PWD/appbody.h \
     $$PWD/icondata.h \
+    $$PWD/imagehint.h \
+    $$PWD/iconcachewriter.h \
+    $$PWD/iconresolver.h \
+    $$PWD/runnablejob.h \
     $$PWD/appbodylabel.h
 
 SOURCES += \
@@ -20,12 +31,21 @@ SOURCES += \
     $$PWD/notifications_dbus_adaptor.cpp \
     $$PWD/dbus_daemon_interface.cpp \
     $$PWD/notificationentity.cpp \
+    $$PWD/notificationrecord.cpp \
     $$PWD/dbuslogin1manager.cpp \
     $$PWD/actionbutton.cpp \
     $$PWD/appicon.cpp\
     $$PWD/dbusdock_interface.cpp \
     $$PWD/dbuscontrol.cpp \
+    $$PWD/notificationhistory.cpp \
     $$PWD/persistence.cpp \
+    $$PWD/persistencebackend.cpp \
+    $$PWD/sqlitebackend.cpp \
+    $$PWD/memorybackend.cpp \
+    $$PWD/logbackend.cpp \
     $$PWD/appbody.cpp \
     $$PWD/icondata.cpp \
+    $$PWD/imagehint.cpp \
+    $$PWD/iconcachewriter.cpp \
+    $$PWD/iconresolver.cpp \
     $$PWD/appbodylabel.cpp